@@ -0,0 +1,127 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <SFML/Graphics.hpp>
+#include "EntityStore.h"
+#include "ThreadPool.h"
+#include "GridOverlay.h"
+
+// Fase amplia intercambiable en tiempo de ejecución. QuadTree,
+// LinearQuadTree, UniformGrid y SweepAndPrune comparten la misma interfaz
+// (build / update / remove / visit / collectCollidingPairs / buildGrid) pero
+// con plantillas, sin funciones virtuales; BroadPhaseOf<T> envuelve
+// cualquiera de ellos detrás de BroadPhase para elegirlo con una tecla o
+// desde la línea de comandos. Las llamadas virtuales son por frame o por
+// entidad, nunca dentro de un recorrido.
+enum class BroadPhaseKind {
+    QuadTree,
+    Grid,
+    SweepAndPrune,
+    Count
+};
+
+constexpr int BROAD_PHASES = static_cast<int>(BroadPhaseKind::Count);
+
+inline const char* broadPhaseName(BroadPhaseKind kind) {
+    switch (kind) {
+        case BroadPhaseKind::QuadTree: return "quadtree";
+        case BroadPhaseKind::Grid: return "grid";
+        case BroadPhaseKind::SweepAndPrune: return "sap";
+        default: return "?";
+    }
+}
+
+// "quadtree", "grid" o "sap"; false si no es ninguno
+inline bool parseBroadPhase(const char* text, BroadPhaseKind& out) {
+    for (int k = 0; k < BROAD_PHASES; ++k) {
+        const auto kind = static_cast<BroadPhaseKind>(k);
+        if (std::strcmp(text, broadPhaseName(kind)) == 0) {
+            out = kind;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline BroadPhaseKind nextBroadPhase(BroadPhaseKind kind) {
+    return static_cast<BroadPhaseKind>((static_cast<int>(kind) + 1) % BROAD_PHASES);
+}
+
+class BroadPhase {
+public:
+    using Id = std::uint32_t;
+    using IdPair = std::pair<Id, Id>; // siempre (menor, mayor)
+
+    virtual ~BroadPhase() = default;
+
+    virtual BroadPhaseKind kind() const = 0;
+
+    // todas las entidades del store (Id = índice)
+    virtual void build(const EntityStore& store, ThreadPool& pool) = 0;
+    virtual void update(Id id, const EntityStore& store) = 0;
+    virtual bool remove(Id id) = 0;
+
+    // termina lo que build/update/remove hayan dejado para después (las
+    // estructuras que se rearman enteras); no hace nada en el QuadTree
+    virtual void flush() = 0;
+
+    // entidades que tocan el rectángulo, agregadas al final de found
+    virtual void queryRange(const sf::FloatRect& range, std::vector<Id>& found) const = 0;
+
+    // true si alguna entidad toca el círculo; corta en la primera
+    virtual bool anyInCircle(const sf::Vector2f& center, float radius) const = 0;
+
+    // pares a menos de scale * (ra + rb), ordenados: el mismo resultado con
+    // cualquier implementación y cualquier cantidad de hilos
+    virtual void collectCollidingPairs(float scale, ThreadPool& pool, std::vector<IdPair>& out) const = 0;
+
+    virtual void buildGrid(GridOverlay& out) const = 0;
+};
+
+template <typename T, typename = void>
+struct HasFlush : std::false_type {};
+
+template <typename T>
+struct HasFlush<T, std::void_t<decltype(std::declval<const T&>().flush())>> : std::true_type {};
+
+template <typename T>
+class BroadPhaseOf final : public BroadPhase {
+    static_assert(std::is_same_v<typename T::IdPair, IdPair>, "T debe usar los mismos Id");
+
+private:
+    T& impl;
+    BroadPhaseKind type;
+
+public:
+    BroadPhaseOf(T& structure, BroadPhaseKind k) : impl(structure), type(k) {}
+
+    T& get() { return impl; }
+    const T& get() const { return impl; }
+
+    BroadPhaseKind kind() const override { return type; }
+
+    void build(const EntityStore& store, ThreadPool& pool) override { impl.build(store, pool); }
+    void update(Id id, const EntityStore& store) override { impl.update(id, store); }
+    bool remove(Id id) override { return impl.remove(id); }
+
+    void flush() override {
+        if constexpr (HasFlush<T>::value) impl.flush();
+    }
+
+    void queryRange(const sf::FloatRect& range, std::vector<Id>& found) const override {
+        impl.queryRange(range, found);
+    }
+
+    bool anyInCircle(const sf::Vector2f& center, float radius) const override {
+        return !impl.visitCircle(center, radius, [](Id) { return false; });
+    }
+
+    void collectCollidingPairs(float scale, ThreadPool& pool, std::vector<IdPair>& out) const override {
+        impl.collectCollidingPairs(scale, pool, out);
+    }
+
+    void buildGrid(GridOverlay& out) const override { impl.buildGrid(out); }
+};
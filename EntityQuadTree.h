@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <SFML/Graphics.hpp>
+#include "QuadTree.h"
+#include "EntityStore.h"
+#include "ThreadPool.h"
+#include "GridOverlay.h"
+
+// centro, radio e índice de cada Id, leídos del EntityStore
+struct StoreShape {
+    const EntityStore* store = nullptr;
+
+    qt::Circle operator()(std::uint32_t id) const {
+        return {{store->x[id], store->y[id]}, store->radius[id]};
+    }
+    std::size_t index(std::uint32_t id) const { return id; }
+};
+
+// El QuadTree del juego: qt::QuadTree sobre los Id del EntityStore, más lo
+// que depende de SFML (la cuadrícula de depuración). El árbol guarda índices
+// en el arreglo de entidades del llamador junto con una copia de la posición
+// y el radio al momento de insertar. Un Id sigue siendo válido aunque el
+// vector del llamador se realoje; solo cambia de significado cuando el
+// llamador compacta el vector (y entonces reconstruye).
+template <std::size_t Capacity>
+class EntityQuadTree : public qt::QuadTree<std::uint32_t, StoreShape, Capacity> {
+    using Base = qt::QuadTree<std::uint32_t, StoreShape, Capacity>;
+
+    mutable GridOverlay grid;
+
+public:
+    using typename Base::Id;
+
+    EntityQuadTree(const sf::FloatRect& bounds, int cap = 4, int depth = Base::MAX_DEPTH)
+        : Base(bounds, cap, depth) {}
+
+    using Base::insert;
+    using Base::build;
+    using Base::update;
+
+    void insert(Id id, const EntityStore& store) {
+        this->shapeFn().store = &store;
+        Base::insert(id);
+    }
+
+    // reconstruye con todas las entidades del store (Id = índice)
+    void build(const EntityStore& store) {
+        this->shapeFn().store = &store;
+        Base::build(store.size(), [](std::size_t i) { return static_cast<Id>(i); });
+    }
+
+    void build(const EntityStore& store, ThreadPool& pool) {
+        this->shapeFn().store = &store;
+        Base::build(store.size(), [](std::size_t i) { return static_cast<Id>(i); }, pool);
+    }
+
+    void update(Id id, const EntityStore& store) {
+        this->shapeFn().store = &store;
+        Base::update(id);
+    }
+
+    // regenera out solo si la estructura cambió desde la última vez; sirve
+    // para armar la cuadrícula fuera del hilo que dibuja
+    void buildGrid(GridOverlay& out) const {
+        if (out.upToDate(this->structureVersion())) return;
+        out.clear();
+        this->forEachNode([&out](const qt::Rect& r, int) {
+            out.addRect(sf::FloatRect({r.x, r.y}, {r.w, r.h}));
+        });
+        out.finish(this->structureVersion());
+    }
+
+    void draw(sf::RenderWindow& window) const {
+        buildGrid(grid);
+        grid.draw(window);
+    }
+};
+
+// cada nodo guarda 8 objetos en su arreglo: una hoja llena con la capacidad
+// por defecto (4) y algunos círculos que cruzan sus divisiones
+using QuadTree = EntityQuadTree<8>;
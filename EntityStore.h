@@ -0,0 +1,108 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <SFML/System/Vector2.hpp>
+
+// Entidades en estructura de arreglos (SoA): la simulación y el QuadTree
+// recorren solo los campos que necesitan, contiguos en memoria. Las formas
+// de SFML se generan recién al dibujar.
+struct EntityStore {
+    enum Flag : std::uint8_t {
+        Colliding = 1 << 0
+    };
+
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> px; // posición al empezar el tick, para interpolar al dibujar
+    std::vector<float> py;
+    std::vector<float> vx;
+    std::vector<float> vy;
+    std::vector<float> radius;
+    std::vector<std::uint8_t> stage; // nivel de fusión (ver colorFromStage)
+    std::vector<std::uint8_t> flags;
+
+    std::size_t size() const { return x.size(); }
+    bool empty() const { return x.empty(); }
+
+    void clear() {
+        x.clear();
+        y.clear();
+        px.clear();
+        py.clear();
+        vx.clear();
+        vy.clear();
+        radius.clear();
+        stage.clear();
+        flags.clear();
+    }
+
+    void reserve(std::size_t n) {
+        x.reserve(n);
+        y.reserve(n);
+        px.reserve(n);
+        py.reserve(n);
+        vx.reserve(n);
+        vy.reserve(n);
+        radius.reserve(n);
+        stage.reserve(n);
+        flags.reserve(n);
+    }
+
+    std::size_t add(const sf::Vector2f& pos, float r, const sf::Vector2f& vel, std::uint8_t fusionStage = 0) {
+        x.push_back(pos.x);
+        y.push_back(pos.y);
+        px.push_back(pos.x);
+        py.push_back(pos.y);
+        vx.push_back(vel.x);
+        vy.push_back(vel.y);
+        radius.push_back(r);
+        stage.push_back(fusionStage);
+        flags.push_back(0);
+        return x.size() - 1;
+    }
+
+    sf::Vector2f position(std::size_t i) const { return {x[i], y[i]}; }
+
+    void setPosition(std::size_t i, const sf::Vector2f& pos) {
+        x[i] = pos.x;
+        y[i] = pos.y;
+    }
+
+    sf::Vector2f velocity(std::size_t i) const { return {vx[i], vy[i]}; }
+
+    // px/py = x/y; se llama al empezar cada tick
+    void savePrevious() {
+        px.assign(x.begin(), x.end());
+        py.assign(y.begin(), y.end());
+    }
+
+    bool has(std::size_t i, Flag f) const { return (flags[i] & f) != 0; }
+
+    // elimina las entidades con alive[i] == false conservando el orden
+    void compact(const std::vector<bool>& alive) {
+        std::size_t out = 0;
+        for (std::size_t i = 0; i < size(); ++i) {
+            if (!alive[i]) continue;
+            x[out] = x[i];
+            y[out] = y[i];
+            px[out] = px[i];
+            py[out] = py[i];
+            vx[out] = vx[i];
+            vy[out] = vy[i];
+            radius[out] = radius[i];
+            stage[out] = stage[i];
+            flags[out] = flags[i];
+            ++out;
+        }
+        x.resize(out);
+        y.resize(out);
+        px.resize(out);
+        py.resize(out);
+        vx.resize(out);
+        vy.resize(out);
+        radius.resize(out);
+        stage.resize(out);
+        flags.resize(out);
+    }
+};
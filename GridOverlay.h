@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <SFML/Graphics.hpp>
+
+// Cuadrícula de depuración de un árbol como lista de líneas: todos los nodos
+// en un solo draw call. El árbol la regenera solo cuando cambia su versión
+// de estructura; clear() conserva la memoria del arreglo.
+class GridOverlay {
+private:
+    sf::VertexArray lines{sf::PrimitiveType::Lines};
+    std::uint64_t builtVersion = 0;
+    bool built = false;
+
+public:
+    bool upToDate(std::uint64_t version) const {
+        return built && builtVersion == version;
+    }
+
+    void clear() {
+        lines.clear();
+        built = false;
+    }
+
+    void addRect(const sf::FloatRect& r) {
+        const sf::Color color(100, 100, 255, 80);
+        const sf::Vector2f a = r.position;
+        const sf::Vector2f b(r.position.x + r.size.x, r.position.y);
+        const sf::Vector2f c(r.position.x + r.size.x, r.position.y + r.size.y);
+        const sf::Vector2f d(r.position.x, r.position.y + r.size.y);
+        sf::Vertex vertex;
+        vertex.color = color;
+        for (const sf::Vector2f& p : {a, b, b, c, c, d, d, a}) {
+            vertex.position = p;
+            lines.append(vertex);
+        }
+    }
+
+    void finish(std::uint64_t version) {
+        builtVersion = version;
+        built = true;
+    }
+
+    void draw(sf::RenderWindow& window) const {
+        window.draw(lines);
+    }
+};
@@ -0,0 +1,532 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <SFML/Graphics.hpp>
+#include "EntityStore.h"
+#include "NarrowPhase.h"
+#include "ThreadPool.h"
+#include "GridOverlay.h"
+
+// QuadTree lineal: las entidades se guardan en arreglos contiguos ordenados
+// por su clave Morton (orden Z) y los nodos se derivan de los prefijos de
+// esas claves. Misma interfaz que QuadTree (reset / insert / queryRange / draw)
+// para poder intercambiar backends desde main.cpp.
+//
+// Es un árbol "loose": cada entidad cae en la celda de su centro y los nodos
+// se amplían con el radio máximo al consultar, asi los círculos grandes se
+// encuentran aunque su centro quede fuera del rango.
+class LinearQuadTree {
+public:
+    using Id = std::uint32_t;
+    using IdPair = std::pair<Id, Id>; // siempre (menor, mayor)
+
+private:
+    static constexpr int MAX_LEVEL = 16; // 16 bits por eje -> clave de 32 bits
+
+    struct Node {
+        std::uint32_t first;   // primer índice en el arreglo ordenado
+        std::uint32_t count;
+        std::int32_t firstChild; // -1 si es hoja; los 4 hijos son contiguos (nw, ne, sw, se)
+        std::uint32_t prefix;  // bits altos de la clave compartidos por el nodo
+        int level;
+    };
+
+    int capacity;
+    int maxLevel; // <= MAX_LEVEL; las hojas de ese nivel no se dividen
+    sf::FloatRect worldBounds;
+
+    // última posición/radio conocidos de cada Id; present = 0 si no está en el árbol
+    struct Entry {
+        sf::Vector2f pos;
+        float radius;
+        bool present;
+    };
+    std::vector<Entry> entries;
+
+    // estado construido; mutable porque se construye de forma perezosa en las consultas
+    mutable bool dirty = false;
+    mutable std::vector<std::uint32_t> keys, keysTmp;
+    mutable std::vector<std::uint32_t> order, orderTmp;
+    mutable std::vector<Id> items;
+    mutable std::vector<float> xs, ys, radii; // en orden Morton, listos para el kernel
+    mutable float maxRadius = 0.f;
+    mutable std::vector<Node> nodes;
+
+    // firstChild de cada nodo en orden de construcción: describe la forma del
+    // árbol; version solo sube cuando cambia entre dos build()
+    mutable std::vector<std::int32_t> shape;
+    mutable std::uint64_t version = 0;
+    mutable GridOverlay grid;
+
+    // tareas del recorrido doble en paralelo: (a, a) = pares dentro de a,
+    // (a, b) = pares entre a y b
+    mutable std::vector<std::pair<std::int32_t, std::int32_t>> pairTasks;
+    mutable std::vector<std::vector<IdPair>> workerPairs;
+
+    // separa los 16 bits bajos dejando un cero entre cada uno
+    static std::uint32_t spreadBits(std::uint32_t v) {
+        v &= 0x0000FFFFu;
+        v = (v | (v << 8)) & 0x00FF00FFu;
+        v = (v | (v << 4)) & 0x0F0F0F0Fu;
+        v = (v | (v << 2)) & 0x33333333u;
+        v = (v | (v << 1)) & 0x55555555u;
+        return v;
+    }
+
+    std::uint32_t quantize(float v, float origin, float size) const {
+        float t = (v - origin) / size * 65536.f;
+        if (t < 0.f) t = 0.f;
+        if (t > 65535.f) t = 65535.f;
+        return static_cast<std::uint32_t>(t);
+    }
+
+    // x en los bits pares, y en los impares: el dígito de cada nivel es
+    // 0 = nw, 1 = ne, 2 = sw, 3 = se, igual que el orden de QuadTree
+    std::uint32_t mortonKey(const sf::Vector2f& p) const {
+        const std::uint32_t qx = quantize(p.x, worldBounds.position.x, worldBounds.size.x);
+        const std::uint32_t qy = quantize(p.y, worldBounds.position.y, worldBounds.size.y);
+        return spreadBits(qx) | (spreadBits(qy) << 1);
+    }
+
+    // radix sort LSD de 8 bits (4 pasadas) sobre las claves, arrastrando el índice
+    void radixSort() const {
+        const std::size_t n = keys.size();
+        keysTmp.resize(n);
+        orderTmp.resize(n);
+
+        for (int shift = 0; shift < 32; shift += 8) {
+            std::size_t histogram[256] = {};
+            for (std::size_t i = 0; i < n; ++i)
+                ++histogram[(keys[i] >> shift) & 0xFFu];
+
+            std::size_t sum = 0;
+            for (auto& h : histogram) {
+                std::size_t c = h;
+                h = sum;
+                sum += c;
+            }
+
+            for (std::size_t i = 0; i < n; ++i) {
+                std::size_t dst = histogram[(keys[i] >> shift) & 0xFFu]++;
+                keysTmp[dst] = keys[i];
+                orderTmp[dst] = order[i];
+            }
+            keys.swap(keysTmp);
+            order.swap(orderTmp);
+        }
+    }
+
+    sf::FloatRect nodeRect(const Node& node) const {
+        // decodifica el prefijo a la celda que cubre el nodo
+        std::uint32_t cx = 0, cy = 0;
+        for (int l = 0; l < node.level; ++l) {
+            const std::uint32_t digit = (node.prefix >> (30 - 2 * l)) & 3u;
+            cx = (cx << 1) | (digit & 1u);
+            cy = (cy << 1) | (digit >> 1);
+        }
+        const float cells = static_cast<float>(1u << node.level);
+        const float w = worldBounds.size.x / cells;
+        const float h = worldBounds.size.y / cells;
+        return sf::FloatRect(
+            {worldBounds.position.x + cx * w, worldBounds.position.y + cy * h},
+            {w, h}
+        );
+    }
+
+    void build() const {
+        dirty = false;
+        const std::size_t n = entries.size();
+
+        keys.clear();
+        order.clear();
+        for (std::size_t i = 0; i < n; ++i) {
+            const Entry& e = entries[i];
+            if (!e.present || !worldBounds.contains(e.pos)) continue; // igual que QuadTree::insert
+            keys.push_back(mortonKey(e.pos));
+            order.push_back(static_cast<std::uint32_t>(i));
+        }
+
+        radixSort();
+
+        items.resize(keys.size());
+        xs.resize(keys.size());
+        ys.resize(keys.size());
+        radii.resize(keys.size());
+        maxRadius = 0.f;
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            items[i] = order[i];
+            xs[i] = entries[order[i]].pos.x;
+            ys[i] = entries[order[i]].pos.y;
+            radii[i] = entries[order[i]].radius;
+            if (radii[i] > maxRadius) maxRadius = radii[i];
+        }
+
+        // jerarquía: cada nodo con más de `capacity` entidades se parte en los
+        // 4 rangos contiguos que comparten el siguiente dígito de la clave
+        nodes.clear();
+        nodes.push_back({0, static_cast<std::uint32_t>(keys.size()), -1, 0u, 0});
+        for (std::size_t i = 0; i < nodes.size(); ++i) {
+            Node node = nodes[i];
+            if ((int)node.count <= capacity || node.level >= maxLevel) continue;
+
+            const int shift = 30 - 2 * node.level;
+            const std::int32_t firstChild = static_cast<std::int32_t>(nodes.size());
+            auto begin = keys.begin() + node.first;
+            auto end   = begin + node.count;
+            std::uint32_t start = node.first;
+
+            for (std::uint32_t digit = 0; digit < 4; ++digit) {
+                const std::uint32_t childPrefix = node.prefix | (digit << shift);
+                auto split = (digit == 3)
+                    ? end
+                    : std::lower_bound(begin, end, childPrefix + (1u << shift));
+                const std::uint32_t stop = static_cast<std::uint32_t>(split - keys.begin());
+                nodes.push_back({start, stop - start, -1, childPrefix, node.level + 1});
+                start = stop;
+            }
+            nodes[i].firstChild = firstChild;
+        }
+
+        bool sameShape = shape.size() == nodes.size();
+        for (std::size_t i = 0; sameShape && i < nodes.size(); ++i)
+            sameShape = shape[i] == nodes[i].firstChild;
+        if (!sameShape) {
+            shape.resize(nodes.size());
+            for (std::size_t i = 0; i < nodes.size(); ++i) shape[i] = nodes[i].firstChild;
+            ++version;
+        }
+    }
+
+    // intersección exacta círculo / rectángulo, igual que QuadTree
+    static bool overlaps(const sf::FloatRect& range, const sf::Vector2f& c, float r) {
+        if (r <= 0.f) return range.contains(c);
+
+        const float nx = std::clamp(c.x, range.position.x, range.position.x + range.size.x);
+        const float ny = std::clamp(c.y, range.position.y, range.position.y + range.size.y);
+        const float dx = c.x - nx;
+        const float dy = c.y - ny;
+        return dx * dx + dy * dy < r * r;
+    }
+
+    // callback que devuelve void sigue siempre; uno que devuelve bool corta con false
+    template <typename F>
+    static bool emit(F& callback, Id id) {
+        if constexpr (std::is_void_v<std::invoke_result_t<F&, Id>>) {
+            callback(id);
+            return true;
+        } else {
+            return static_cast<bool>(callback(id));
+        }
+    }
+
+    // rectángulo del nodo ampliado con el radio máximo (cota "loose")
+    sf::FloatRect looseRect(const Node& node) const {
+        const float padX = maxRadius + worldBounds.size.x / 65536.f;
+        const float padY = maxRadius + worldBounds.size.y / 65536.f;
+        sf::FloatRect r = nodeRect(node);
+        r.position.x -= padX;
+        r.position.y -= padY;
+        r.size.x += 2.f * padX;
+        r.size.y += 2.f * padY;
+        return r;
+    }
+
+    static bool boxesOverlap(const sf::FloatRect& a, const sf::FloatRect& b) {
+        return a.position.x < b.position.x + b.size.x && b.position.x < a.position.x + a.size.x &&
+               a.position.y < b.position.y + b.size.y && b.position.y < a.position.y + a.size.y;
+    }
+
+    // prueba círculo contra círculo con el kernel vectorizado
+    struct CircleTest {
+        const LinearQuadTree& tree;
+        float scale;
+
+        template <typename F>
+        void operator()(std::uint32_t i, std::uint32_t first, std::uint32_t count, F& callback) const {
+            narrow::forEachOverlap(tree.xs[i], tree.ys[i], tree.radii[i],
+                                   tree.xs.data() + first, tree.ys.data() + first,
+                                   tree.radii.data() + first, count, scale,
+                                   [&](std::size_t k) {
+                                       callback(tree.items[i], tree.items[first + k]);
+                                   });
+        }
+    };
+
+    // pares dentro de un mismo nodo: los de cada hijo y los de cada pareja de hijos
+    template <typename Test, typename F>
+    void selfPairs(std::int32_t index, const Test& test, F& callback) const {
+        const Node& node = nodes[index];
+        if (node.count < 2) return;
+
+        if (node.firstChild < 0) {
+            const std::uint32_t end = node.first + node.count;
+            for (std::uint32_t i = node.first; i + 1 < end; ++i)
+                test(i, i + 1, end - i - 1, callback);
+            return;
+        }
+
+        for (int c = 0; c < 4; ++c) {
+            selfPairs(node.firstChild + c, test, callback);
+            for (int d = c + 1; d < 4; ++d)
+                crossPairs(node.firstChild + c, node.firstChild + d, test, callback);
+        }
+    }
+
+    // pares entre dos nodos disjuntos; se poda cuando sus cotas loose no se tocan
+    template <typename Test, typename F>
+    void crossPairs(std::int32_t a, std::int32_t b, const Test& test, F& callback) const {
+        const Node& na = nodes[a];
+        const Node& nb = nodes[b];
+        if (na.count == 0 || nb.count == 0) return;
+        if (!boxesOverlap(looseRect(na), looseRect(nb))) return;
+
+        if (na.firstChild < 0 && nb.firstChild < 0) {
+            for (std::uint32_t i = na.first; i < na.first + na.count; ++i)
+                test(i, nb.first, nb.count, callback);
+        } else if (na.firstChild >= 0 && (nb.firstChild < 0 || na.level <= nb.level)) {
+            for (int c = 0; c < 4; ++c) crossPairs(na.firstChild + c, b, test, callback);
+        } else {
+            for (int c = 0; c < 4; ++c) crossPairs(a, nb.firstChild + c, test, callback);
+        }
+    }
+
+    void collectTasks(std::int32_t index, int depth, int splitDepth) const {
+        const Node& node = nodes[index];
+        if (node.count < 2) return;
+        if (node.firstChild < 0 || depth == splitDepth) {
+            pairTasks.emplace_back(index, index);
+            return;
+        }
+        for (int c = 0; c < 4; ++c) {
+            collectTasks(node.firstChild + c, depth + 1, splitDepth);
+            for (int d = c + 1; d < 4; ++d)
+                pairTasks.emplace_back(node.firstChild + c, node.firstChild + d);
+        }
+    }
+
+    void ensureBuilt() const {
+        if (dirty) build();
+    }
+
+public:
+    LinearQuadTree(const sf::FloatRect& bounds, int cap = 4, int depth = MAX_LEVEL)
+        : capacity(cap), maxLevel(std::clamp(depth, 0, MAX_LEVEL)), worldBounds(bounds) {}
+
+    // igual que QuadTree::setLimits; aquí basta con reconstruir en la próxima consulta
+    void setLimits(int cap, int depth) {
+        capacity = cap > 0 ? cap : 1;
+        maxLevel = std::clamp(depth, 0, MAX_LEVEL);
+        dirty = true;
+    }
+
+    int capacityLimit() const { return capacity; }
+    int depthLimit() const { return maxLevel; }
+
+    void reset() {
+        entries.clear();
+        dirty = true;
+    }
+
+    // la construcción se difiere hasta la primera consulta
+    void insert(Id id, const sf::Vector2f& pos, float radius) {
+        if (id >= entries.size()) entries.resize(id + 1, {{0.f, 0.f}, 0.f, false});
+        entries[id] = {pos, radius, true};
+        dirty = true;
+    }
+
+    void insert(Id id, const EntityStore& store) {
+        insert(id, store.position(id), store.radius[id]);
+    }
+
+    // reconstruye con todas las entidades del store (Id = índice)
+    void build(const EntityStore& store) {
+        reset();
+        for (std::size_t i = 0; i < store.size(); ++i)
+            insert(static_cast<Id>(i), store);
+    }
+
+    // misma interfaz que QuadTree::build(store, pool); aquí el orden Morton se
+    // calcula de forma perezosa y en serie en la primera consulta
+    void build(const EntityStore& store, ThreadPool&) {
+        build(store);
+    }
+
+    // sin estructura incremental: update/remove solo marcan para reconstruir
+    void update(Id id, const sf::Vector2f& pos, float radius) {
+        insert(id, pos, radius);
+    }
+
+    void update(Id id, const EntityStore& store) {
+        insert(id, store);
+    }
+
+    bool remove(Id id) {
+        if (!contains(id)) return false;
+        entries[id].present = false;
+        dirty = true;
+        return true;
+    }
+
+    // arma ya lo que update()/remove() dejaron pendiente, para que su costo
+    // se mida donde se causó y no en la próxima consulta
+    void flush() const {
+        ensureBuilt();
+    }
+
+    bool contains(Id id) const {
+        return id < entries.size() && entries[id].present;
+    }
+
+    // llama a callback(id) por cada entidad que toca el rectángulo, sin
+    // reservar memoria; si callback devuelve bool, false detiene el recorrido
+    template <typename F>
+    bool visit(const sf::FloatRect& range, F&& callback) const {
+        ensureBuilt();
+        if (nodes.empty()) return true;
+
+        // margen del radio máximo más una celda: la cuantización puede dejar
+        // una entidad justo fuera del rectángulo exacto de su nodo
+        const float padX = maxRadius + worldBounds.size.x / 65536.f;
+        const float padY = maxRadius + worldBounds.size.y / 65536.f;
+
+        std::int32_t stack[4 * MAX_LEVEL + 4];
+        int top = 0;
+        stack[top++] = 0;
+
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            if (node.count == 0) continue;
+
+            sf::FloatRect r = nodeRect(node);
+            r.position.x -= padX;
+            r.position.y -= padY;
+            r.size.x += 2.f * padX;
+            r.size.y += 2.f * padY;
+            if (!r.findIntersection(range).has_value()) continue;
+
+            if (node.firstChild < 0) {
+                for (std::uint32_t i = node.first; i < node.first + node.count; ++i) {
+                    if (overlaps(range, {xs[i], ys[i]}, radii[i]) && !emit(callback, items[i]))
+                        return false;
+                }
+            } else {
+                for (int c = 3; c >= 0; --c)
+                    stack[top++] = node.firstChild + c;
+            }
+        }
+        return true;
+    }
+
+    // igual que visit() pero contra el círculo (center, radius); poda
+    // por la distancia al rectángulo "loose" en vez de la caja del círculo
+    template <typename F>
+    bool visitCircle(const sf::Vector2f& center, float radius, F&& callback) const {
+        ensureBuilt();
+        if (nodes.empty()) return true;
+
+        std::int32_t stack[4 * MAX_LEVEL + 4];
+        int top = 0;
+        stack[top++] = 0;
+
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            if (node.count == 0) continue;
+
+            const sf::FloatRect r = looseRect(node);
+            const float nx = std::clamp(center.x, r.position.x, r.position.x + r.size.x);
+            const float ny = std::clamp(center.y, r.position.y, r.position.y + r.size.y);
+            const float ddx = center.x - nx;
+            const float ddy = center.y - ny;
+            if (ddx * ddx + ddy * ddy > radius * radius) continue;
+
+            if (node.firstChild < 0) {
+                for (std::uint32_t i = node.first; i < node.first + node.count; ++i) {
+                    const float dx = xs[i] - center.x;
+                    const float dy = ys[i] - center.y;
+                    const float lim = radius + radii[i];
+                    if (dx * dx + dy * dy < lim * lim && !emit(callback, items[i]))
+                        return false;
+                }
+            } else {
+                for (int c = 3; c >= 0; --c)
+                    stack[top++] = node.firstChild + c;
+            }
+        }
+        return true;
+    }
+
+    void queryRange(const sf::FloatRect& range, std::vector<Id>& found) const {
+        visit(range, [&found](Id id) { found.push_back(id); });
+    }
+
+    void queryCircle(const sf::Vector2f& center, float radius, std::vector<Id>& found) const {
+        visitCircle(center, radius, [&found](Id id) { found.push_back(id); });
+    }
+
+    // recorrido doble del árbol: cada par cuyos círculos están a menos de
+    // scale * (ra + rb), con scale <= 1, se reporta una vez
+    template <typename F>
+    void forEachCollidingPair(float scale, F&& callback) const {
+        ensureBuilt();
+        if (!nodes.empty()) selfPairs(0, CircleTest{*this, scale}, callback);
+    }
+
+    // los mismos pares que forEachCollidingPair repartidos entre los hilos del
+    // pool y ordenados por (menor, mayor): el resultado no depende de los hilos
+    void collectCollidingPairs(float scale, ThreadPool& pool, std::vector<IdPair>& out) const {
+        ensureBuilt();
+        out.clear();
+        if (nodes.empty()) return;
+
+        const unsigned threads = pool.size();
+        int splitDepth = 0;
+        while ((1u << (2 * splitDepth)) < 4u * threads) ++splitDepth;
+
+        pairTasks.clear();
+        collectTasks(0, 0, splitDepth);
+        workerPairs.resize(threads);
+        for (auto& buffer : workerPairs) buffer.clear();
+
+        const CircleTest test{*this, scale};
+        pool.parallelFor(pairTasks.size(), [&](std::size_t t, unsigned w) {
+            std::vector<IdPair>& buffer = workerPairs[w];
+            auto emit = [&](Id a, Id b) {
+                buffer.emplace_back(a < b ? a : b, a < b ? b : a);
+            };
+            const auto task = pairTasks[t];
+            if (task.first == task.second)
+                selfPairs(task.first, test, emit);
+            else
+                crossPairs(task.first, task.second, test, emit);
+        });
+
+        for (const auto& buffer : workerPairs)
+            out.insert(out.end(), buffer.begin(), buffer.end());
+        std::sort(out.begin(), out.end());
+    }
+
+    // cambia solo cuando cambia la forma del árbol (no al mover entidades
+    // dentro de sus nodos)
+    std::uint64_t structureVersion() const {
+        ensureBuilt();
+        return version;
+    }
+
+    // igual que QuadTree::buildGrid
+    void buildGrid(GridOverlay& out) const {
+        ensureBuilt();
+        if (out.upToDate(version)) return;
+        out.clear();
+        for (const Node& node : nodes) out.addRect(nodeRect(node));
+        out.finish(version);
+    }
+
+    void draw(sf::RenderWindow& window) const {
+        buildGrid(grid);
+        grid.draw(window);
+    }
+};
@@ -0,0 +1,114 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NARROW_PHASE_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NARROW_PHASE_SSE2 1
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// Fase estrecha: un círculo contra un bloque empaquetado de círculos (x[], y[], r[]
+// contiguos). Usa distancias al cuadrado, sin sqrt, y devuelve una máscara de
+// bits con los que se solapan. El conjunto de instrucciones (AVX2, SSE2 o escalar)
+// se elige al compilar.
+namespace narrow {
+
+constexpr int BLOCK = 32; // bits de la máscara
+
+inline const char* kernelName() {
+#if defined(NARROW_PHASE_AVX2)
+    return "AVX2";
+#elif defined(NARROW_PHASE_SSE2)
+    return "SSE2";
+#else
+    return "escalar";
+#endif
+}
+
+// bit k encendido si dist(c, k) < scale * (cr + rs[k]); n <= BLOCK
+inline std::uint32_t overlapMaskScalar(float cx, float cy, float cr,
+                                       const float* xs, const float* ys, const float* rs,
+                                       int n, float scale) {
+    std::uint32_t mask = 0;
+    for (int k = 0; k < n; ++k) {
+        const float dx = xs[k] - cx;
+        const float dy = ys[k] - cy;
+        const float lim = (cr + rs[k]) * scale;
+        if (dx * dx + dy * dy < lim * lim) mask |= 1u << k;
+    }
+    return mask;
+}
+
+inline std::uint32_t overlapMask(float cx, float cy, float cr,
+                                 const float* xs, const float* ys, const float* rs,
+                                 int n, float scale = 1.f) {
+    int k = 0;
+    std::uint32_t mask = 0;
+
+#if defined(NARROW_PHASE_AVX2)
+    const __m256 vx = _mm256_set1_ps(cx);
+    const __m256 vy = _mm256_set1_ps(cy);
+    const __m256 vr = _mm256_set1_ps(cr);
+    const __m256 vs = _mm256_set1_ps(scale);
+    for (; k + 8 <= n; k += 8) {
+        const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(xs + k), vx);
+        const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(ys + k), vy);
+        const __m256 lim = _mm256_mul_ps(_mm256_add_ps(vr, _mm256_loadu_ps(rs + k)), vs);
+        const __m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+        const __m256 hit = _mm256_cmp_ps(d2, _mm256_mul_ps(lim, lim), _CMP_LT_OQ);
+        mask |= static_cast<std::uint32_t>(_mm256_movemask_ps(hit)) << k;
+    }
+#elif defined(NARROW_PHASE_SSE2)
+    const __m128 vx = _mm_set1_ps(cx);
+    const __m128 vy = _mm_set1_ps(cy);
+    const __m128 vr = _mm_set1_ps(cr);
+    const __m128 vs = _mm_set1_ps(scale);
+    for (; k + 4 <= n; k += 4) {
+        const __m128 dx = _mm_sub_ps(_mm_loadu_ps(xs + k), vx);
+        const __m128 dy = _mm_sub_ps(_mm_loadu_ps(ys + k), vy);
+        const __m128 lim = _mm_mul_ps(_mm_add_ps(vr, _mm_loadu_ps(rs + k)), vs);
+        const __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        const __m128 hit = _mm_cmplt_ps(d2, _mm_mul_ps(lim, lim));
+        mask |= static_cast<std::uint32_t>(_mm_movemask_ps(hit)) << k;
+    }
+#endif
+
+    if (k < n)
+        mask |= overlapMaskScalar(cx, cy, cr, xs + k, ys + k, rs + k, n - k, scale) << k;
+    return mask;
+}
+
+inline int lowestBit(std::uint32_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// llama a hit(k) por cada círculo del arreglo que se solapa con (cx, cy, cr)
+template <typename F>
+inline void forEachOverlap(float cx, float cy, float cr,
+                           const float* xs, const float* ys, const float* rs,
+                           std::size_t n, float scale, F&& hit) {
+    for (std::size_t base = 0; base < n; base += BLOCK) {
+        const int count = static_cast<int>((n - base < BLOCK) ? n - base : BLOCK);
+        std::uint32_t mask = overlapMask(cx, cy, cr, xs + base, ys + base, rs + base, count, scale);
+        while (mask) {
+            const int k = lowestBit(mask);
+            mask &= mask - 1;
+            hit(base + static_cast<std::size_t>(k));
+        }
+    }
+}
+
+} // namespace narrow
@@ -0,0 +1,217 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <SFML/Graphics.hpp>
+
+// Perfilador por fases del frame. Los tiempos de cada frame van a un buffer
+// circular; el overlay muestra promedios y una gráfica del tiempo por frame,
+// y writeTrace() vuelca los últimos eventos en formato Chrome trace
+// (chrome://tracing o ui.perfetto.dev). Apagado, Scope no lee el reloj: el
+// costo es una comparación por fase.
+class Profiler {
+public:
+    enum class Phase {
+        Input,
+        Move,
+        Spawn,
+        Build,
+        Collide,
+        Resolve,
+        Player,
+        Compact,
+        View,
+        Render,
+        Display,
+        Count
+    };
+
+    static constexpr int PHASES = static_cast<int>(Phase::Count);
+    static constexpr int HISTORY = 240;          // frames guardados
+    static constexpr int EVENTS = HISTORY * 16;  // eventos para el trace
+
+    using Clock = std::chrono::steady_clock;
+
+    // mide desde la construcción hasta el final del bloque
+    class Scope {
+    private:
+        Profiler* profiler;
+        Phase phase;
+        Clock::time_point start;
+
+    public:
+        Scope(Profiler& p, Phase ph) : profiler(p.enabled() ? &p : nullptr), phase(ph) {
+            if (profiler) start = Clock::now();
+        }
+        ~Scope() {
+            if (profiler) profiler->record(phase, start, Clock::now());
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+private:
+    struct Frame {
+        std::array<std::int64_t, PHASES> ns{};
+        std::int64_t total = 0;
+    };
+
+    struct Event {
+        int phase; // -1 = frame completo
+        std::int64_t start;
+        std::int64_t duration;
+    };
+
+    bool on = false;
+    Clock::time_point origin = Clock::now();
+    Clock::time_point frameStart;
+    Frame current;
+
+    std::array<Frame, HISTORY> frames{};
+    int frameHead = 0;  // próximo frame a escribir
+    int frameCount = 0;
+
+    std::array<Event, EVENTS> events{};
+    int eventHead = 0;
+    int eventCount = 0;
+
+    sf::VertexArray graph{sf::PrimitiveType::Lines};
+
+    std::int64_t sinceOrigin(Clock::time_point t) const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(t - origin).count();
+    }
+
+    void pushEvent(int phase, Clock::time_point start, Clock::time_point end) {
+        events[eventHead] = {phase, sinceOrigin(start), sinceOrigin(end) - sinceOrigin(start)};
+        eventHead = (eventHead + 1) % EVENTS;
+        if (eventCount < EVENTS) ++eventCount;
+    }
+
+public:
+    static const char* name(int phase) {
+        static const char* names[PHASES] = {
+            "entrada", "mover", "spawn", "arbol", "pares",
+            "fusion", "jugador", "compactar", "vista", "dibujo", "display"
+        };
+        return phase >= 0 && phase < PHASES ? names[phase] : "frame";
+    }
+
+    bool enabled() const { return on; }
+
+    void setEnabled(bool value) {
+        on = value;
+        current = Frame{};
+        frameStart = Clock::now();
+    }
+
+    void toggle() { setEnabled(!on); }
+
+    void beginFrame() {
+        if (!on) return;
+        current = Frame{};
+        frameStart = Clock::now();
+    }
+
+    void endFrame() {
+        if (!on) return;
+        const Clock::time_point end = Clock::now();
+        current.total = sinceOrigin(end) - sinceOrigin(frameStart);
+        pushEvent(-1, frameStart, end);
+
+        frames[frameHead] = current;
+        frameHead = (frameHead + 1) % HISTORY;
+        if (frameCount < HISTORY) ++frameCount;
+    }
+
+    void record(Phase phase, Clock::time_point start, Clock::time_point end) {
+        if (!on) return;
+        current.ns[static_cast<int>(phase)] += sinceOrigin(end) - sinceOrigin(start);
+        pushEvent(static_cast<int>(phase), start, end);
+    }
+
+    // duración medida en otro hilo (la simulación): cuenta en el frame actual
+    // pero no va al trace, que es una sola línea de tiempo
+    void add(Phase phase, std::int64_t ns) {
+        if (!on) return;
+        current.ns[static_cast<int>(phase)] += ns;
+    }
+
+    // promedio en ms de una fase (o del frame con phase = -1) en el historial
+    double averageMs(int phase) const {
+        if (frameCount == 0) return 0.0;
+        std::int64_t sum = 0;
+        for (int i = 0; i < frameCount; ++i)
+            sum += phase < 0 ? frames[i].total : frames[i].ns[phase];
+        return sum / 1e6 / frameCount;
+    }
+
+    // eventos "X" (completos) de Chrome trace, en microsegundos
+    bool writeTrace(const char* path) const {
+        std::FILE* f = std::fopen(path, "w");
+        if (!f) return false;
+
+        std::fprintf(f, "{\"traceEvents\":[\n");
+        const int first = (eventHead - eventCount + EVENTS) % EVENTS;
+        for (int k = 0; k < eventCount; ++k) {
+            const Event& e = events[(first + k) % EVENTS];
+            std::fprintf(f,
+                         "{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"ts\":%.3f,"
+                         "\"dur\":%.3f,\"pid\":1,\"tid\":1}%s\n",
+                         name(e.phase), e.start / 1e3, e.duration / 1e3,
+                         k + 1 < eventCount ? "," : "");
+        }
+        std::fprintf(f, "],\"displayTimeUnit\":\"ms\"}\n");
+        std::fclose(f);
+        return true;
+    }
+
+    // promedios por fase y gráfica de los últimos HISTORY frames; la línea
+    // clara marca 16.7 ms (60 fps)
+    void draw(sf::RenderWindow& window, const sf::Font* font, const sf::Vector2f& origin) {
+        if (!on) return;
+
+        const float barScale = 3.f; // px por ms
+        const float height = 60.f;
+        const sf::Vector2f base(origin.x, origin.y + height);
+
+        graph.clear();
+        sf::Vertex v;
+        v.color = sf::Color(255, 255, 255, 90);
+        v.position = {base.x, base.y - 16.7f * barScale};
+        graph.append(v);
+        v.position = {base.x + HISTORY, base.y - 16.7f * barScale};
+        graph.append(v);
+
+        const int first = (frameHead - frameCount + HISTORY) % HISTORY;
+        for (int k = 0; k < frameCount; ++k) {
+            const Frame& fr = frames[(first + k) % HISTORY];
+            float h = static_cast<float>(fr.total / 1e6) * barScale;
+            if (h > height) h = height;
+            v.color = fr.total > 16'700'000 ? sf::Color(255, 80, 80) : sf::Color(80, 255, 120);
+            v.position = {base.x + k, base.y};
+            graph.append(v);
+            v.position = {base.x + k, base.y - h};
+            graph.append(v);
+        }
+        window.draw(graph);
+
+        if (!font) return;
+        char line[64];
+        std::snprintf(line, sizeof(line), "frame %6.2f ms\n", averageMs(-1));
+        std::string msg = line;
+        for (int p = 0; p < PHASES; ++p) {
+            std::snprintf(line, sizeof(line), "%-9s %6.3f ms\n", name(p), averageMs(p));
+            msg += line;
+        }
+        msg += "[F3] ocultar | [F4] trace.json";
+
+        sf::Text t(*font, msg, 12);
+        t.setPosition(sf::Vector2f(origin.x, origin.y + height + 6.f));
+        t.setFillColor(sf::Color::White);
+        t.setOutlineColor(sf::Color::Black);
+        t.setOutlineThickness(1.f);
+        window.draw(t);
+    }
+};
@@ -1,145 +1,1419 @@
 #pragma once
+#include <array>
 #include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <optional>
-#include <SFML/Graphics.hpp>
-#include "Entity.h"
+#include <type_traits>
+#include <utility>
+#include "NarrowPhase.h"
+#include "ThreadPool.h"
 
+// Contadores por consulta (nodos visitados, entidades probadas y devueltas):
+// activos por defecto en debug y fuera en release (NDEBUG); se pueden forzar
+// con -DQUADTREE_STATS=0 o 1.
+#ifndef QUADTREE_STATS
+#ifdef NDEBUG
+#define QUADTREE_STATS 0
+#else
+#define QUADTREE_STATS 1
+#endif
+#endif
+
+#if QUADTREE_STATS
+#define QUADTREE_COUNT(expr) (expr)
+#else
+#define QUADTREE_COUNT(expr) ((void)0)
+#endif
+
+// QuadTree de círculos solo cabecera y sin SFML: el juego lo usa a través de
+// EntityQuadTree.h y cualquier otro código (un servidor, por ejemplo) puede
+// usarlo tal cual con el target `quadtree` de CMake.
+namespace qt {
+
+// punto o vector; se construye también desde cualquier tipo con .x y .y
+// (sf::Vector2f, por ejemplo), asi el juego pasa los suyos sin convertir
+struct Vec2 {
+    float x = 0.f;
+    float y = 0.f;
+
+    constexpr Vec2() = default;
+    constexpr Vec2(float px, float py) : x(px), y(py) {}
+
+    template <typename V,
+              typename = std::enable_if_t<!std::is_same_v<V, Vec2>>,
+              typename = decltype(float(std::declval<const V&>().x) + float(std::declval<const V&>().y))>
+    constexpr Vec2(const V& v) : x(v.x), y(v.y) {}
+};
+
+// rectángulo semiabierto [x, x + w) x [y, y + h), igual que sf::FloatRect;
+// se construye también desde cualquier tipo con .position y .size
+struct Rect {
+    float x = 0.f;
+    float y = 0.f;
+    float w = 0.f;
+    float h = 0.f;
+
+    constexpr Rect() = default;
+    constexpr Rect(float px, float py, float pw, float ph) : x(px), y(py), w(pw), h(ph) {}
+
+    template <typename R,
+              typename = decltype(float(std::declval<const R&>().position.x) +
+                                  float(std::declval<const R&>().size.x))>
+    constexpr Rect(const R& r) : x(r.position.x), y(r.position.y), w(r.size.x), h(r.size.y) {}
+
+    bool contains(const Vec2& p) const {
+        return p.x >= x && p.x < x + w && p.y >= y && p.y < y + h;
+    }
+
+    bool intersects(const Rect& o) const {
+        return x < o.x + o.w && o.x < x + w && y < o.y + o.h && o.y < y + h;
+    }
+};
+
+// lo que devuelve ShapeFn por cada valor: centro y radio (0 para un punto)
+struct Circle {
+    Vec2 center;
+    float radius = 0.f;
+};
+
+namespace detail {
+template <typename S, typename T, typename = void>
+struct HasIndex : std::false_type {};
+template <typename S, typename T>
+struct HasIndex<S, T, std::void_t<decltype(std::size_t(std::declval<const S&>().index(std::declval<const T&>())))>>
+    : std::true_type {};
+} // namespace detail
+
+// Guarda valores T (en el juego, el Id de cada entidad en el EntityStore)
+// con una copia del círculo que da shape(t) al insertar. T se compara con ==
+// y < (empates y pares en orden). Si ShapeFn también tiene index(t), un
+// índice denso por valor, remove(), update() y contains() encuentran el nodo
+// en O(1); sin index() esas tres no compilan.
+//
+// Capacity es fija en compilación: cada nodo guarda sus objetos en un arreglo
+// propio, sin memoria dinámica por nodo. Lo que no entra (los círculos que
+// cruzan divisiones de un nodo interno, las hojas en maxDepth o un capacity
+// mayor que Capacity) sigue en cubetas de desborde encadenadas, del mismo
+// tamaño y de un pool que reset() rebobina sin liberar.
+template <typename T, typename ShapeFn, std::size_t Capacity = 8>
 class QuadTree {
+    static_assert(Capacity > 0, "Capacity debe ser mayor que 0");
+    static_assert(std::is_default_constructible_v<T> && std::is_copy_assignable_v<T>,
+                  "T se guarda por valor en arreglos fijos");
+
+    static constexpr bool INDEXED = detail::HasIndex<ShapeFn, T>::value;
+
+public:
+    using Id = T;
+    using IdPair = std::pair<Id, Id>; // siempre (menor, mayor)
+
+    // profundidad máxima por defecto; con el radio en 0 nada impide que
+    // entidades en el mismo punto dividan para siempre
+    static constexpr int MAX_DEPTH = 16;
+
+    // primer impacto de raycast(): punto = origin + t * dir
+    struct RayHit {
+        Id id;
+        float t;
+    };
+
+    // foto de la forma del árbol, ver stats()
+    struct Stats {
+        std::size_t nodes = 0;
+        std::size_t leaves = 0;
+        std::size_t entities = 0;
+        std::size_t straddlers = 0;    // entidades guardadas en nodos internos
+        int maxDepth = 0;
+        std::size_t overflowLeaves = 0; // hojas en la profundidad máxima con más de capacity
+        double averageLeafDepth = 0.0;
+        double averageEntityDepth = 0.0;
+        double entitiesPerLeaf = 0.0;
+        std::vector<std::size_t> leafOccupancy; // [k] = hojas con k entidades
+    };
+
+    // acumulados desde el último resetQueryCounters(); siempre en cero si
+    // QUADTREE_STATS está apagado
+    struct QueryCounters {
+        std::uint64_t queries = 0;
+        std::uint64_t nodesVisited = 0;
+        std::uint64_t entitiesTested = 0;
+        std::uint64_t entitiesReturned = 0;
+        // búsqueda de pares: candidatos que llegan al kernel y pares que pasan
+        std::uint64_t pairSearches = 0;
+        std::uint64_t pairsTested = 0;
+        std::uint64_t pairsFound = 0;
+    };
+
+    // ns de cada etapa del último build(count, itemAt, pool): partir los
+    // niveles de arriba (en serie), describir los subárboles, pedir los nodos
+    // y las cubetas al pool (en serie) y llenarlos
+    struct BuildTimes {
+        std::int64_t split = 0;
+        std::int64_t layout = 0;
+        std::int64_t nodes = 0;
+        std::int64_t fill = 0;
+    };
+
 private:
+    struct Item {
+        Id id;
+        Vec2 pos;
+        float radius;
+
+        Rect bounds() const {
+            return Rect(pos.x - radius, pos.y - radius, 2.f * radius, 2.f * radius);
+        }
+    };
+
+    // objetos de un nodo en estructura de arreglos, en un arreglo fijo: xs,
+    // ys y rs se pasan tal cual al kernel de narrow::overlapMask. Cada nodo
+    // trae la suya; las de desborde salen del pool
+    struct Bucket {
+        std::array<Id, Capacity> ids;
+        std::array<float, Capacity> xs;
+        std::array<float, Capacity> ys;
+        std::array<float, Capacity> rs;
+        std::size_t count = 0;
+        Bucket* next = nullptr;
+
+        Item operator[](std::size_t i) const { return {ids[i], {xs[i], ys[i]}, rs[i]}; }
+
+        void set(std::size_t i, const Item& item) {
+            ids[i] = item.id;
+            xs[i] = item.pos.x;
+            ys[i] = item.pos.y;
+            rs[i] = item.radius;
+        }
+    };
+
+    // pila de objetos en estructura de arreglos, para los recorridos de pares
+    struct Items {
+        std::vector<Id> ids;
+        std::vector<float> xs;
+        std::vector<float> ys;
+        std::vector<float> rs;
+
+        std::size_t size() const { return ids.size(); }
+        std::size_t capacity() const { return ids.capacity(); }
+
+        void push_back(const Item& item) {
+            ids.push_back(item.id);
+            xs.push_back(item.pos.x);
+            ys.push_back(item.pos.y);
+            rs.push_back(item.radius);
+        }
+
+        void resize(std::size_t n) {
+            ids.resize(n);
+            xs.resize(n);
+            ys.resize(n);
+            rs.resize(n);
+        }
+
+        void clear() { resize(0); }
+
+        void reserve(std::size_t n) {
+            ids.reserve(n);
+            xs.reserve(n);
+            ys.reserve(n);
+            rs.reserve(n);
+        }
+    };
+
     struct Node {
-        sf::FloatRect boundary;
+        Rect boundary;
         int capacity;
+        int depth;
         bool divided;
-        std::vector<Entity*> objects;
+        int count;     // entidades en todo el subárbol
+        int size;      // objetos propios, en objects y sus cubetas de desborde
+        Bucket objects;
+        Bucket* tail;  // última cubeta de la cadena (objects si no hay desborde)
+        Node* parent;
         Node* nw;
         Node* ne;
         Node* sw;
         Node* se;
 
-        Node(const sf::FloatRect& bounds, int cap)
-            : boundary(bounds), capacity(cap), divided(false),
-              nw(nullptr), ne(nullptr), sw(nullptr), se(nullptr) {}
+        Node()
+            : capacity(0), depth(0), divided(false), count(0), size(0), tail(&objects),
+              parent(nullptr), nw(nullptr), ne(nullptr), sw(nullptr), se(nullptr) {}
+    };
+
+    // pools de nodos y de cubetas: bloques fijos que nunca se liberan hasta
+    // destruir el árbol, asi reset() solo rebobina los contadores y la
+    // memoria se reutiliza
+    static constexpr std::size_t CHUNK_SIZE = 256;
+
+    std::vector<std::unique_ptr<Node[]>> chunks;
+    std::size_t nodesUsed = 0;
+    std::vector<std::unique_ptr<Bucket[]>> bucketChunks;
+    std::size_t bucketsUsed = 0;
+    // reservas de heap de todo lo que guarda el árbol, también de los buffers
+    // de las consultas (por eso mutable) y de los vectores de salida que crecen
+    mutable std::size_t allocations = 0;
+    std::vector<Node*> freeNodes;     // nodos devueltos por merge(), se reutilizan primero
+    std::vector<Bucket*> freeBuckets; // cubetas devueltas al vaciar o achicar una cadena
+    std::vector<Item> scratch;        // buffer reutilizado por subdivide()
+
+    // nodo donde está guardado cada valor, por shape.index(). Una entrada
+    // solo vale si su stamp es el actual: reset() sube el stamp en vez de
+    // recorrer el arreglo
+    struct Slot {
+        Node* node;
+        std::uint32_t stamp;
+    };
+    std::vector<Slot> nodeOf;
+    std::uint32_t stamp = 1;
+
+    mutable Items ancestors; // pila reutilizada por los recorridos de pares
+    mutable QueryCounters counters;
+
+    // montículos reutilizados por nearest(): nodos por distancia (mínimo
+    // arriba) y los k mejores candidatos (el peor arriba)
+    struct NodeDist {
+        float d2;
+        Node* node;
+        bool operator<(const NodeDist& o) const { return d2 > o.d2; }
+    };
+    struct Candidate {
+        float d2;
+        Id id;
+        bool operator<(const Candidate& o) const { return d2 < o.d2 || (d2 == o.d2 && id < o.id); }
+    };
+    mutable std::vector<NodeDist> nodeHeap;
+    mutable std::vector<Candidate> bestHeap;
+
+    // estado reutilizado por collectCollidingPairs(): una pila y un buffer de
+    // pares por trabajador, y la lista de tareas (subárboles) del frame
+    struct PairTask {
+        Node* node;
+        bool subtree; // false: solo los objetos propios del nodo
+    };
+    struct PairWork {
+        std::uint64_t tested = 0;    // candidatos probados (solo con QUADTREE_STATS)
+        std::size_t allocations = 0; // reservas de la pila y del buffer de pares
+    };
+    mutable std::vector<PairTask> pairTasks;
+    mutable std::vector<Items> workerStacks;
+    mutable std::vector<std::vector<IdPair>> workerPairs;
+    mutable std::vector<PairWork> workerWork;
+
+    // estado reutilizado por build(count, itemAt, pool): las entidades se
+    // reparten sobre buildItems y cada subárbol se describe primero en
+    // BuildNode (en paralelo), luego se piden los nodos y las cubetas al pool
+    // (en serie) y al final se enlazan y se llenan (en paralelo)
+    struct BuildNode {
+        Rect boundary;
+        std::size_t first; // objetos propios: buildItems[first, first + own)
+        std::size_t own;
+        std::size_t count; // entidades en el subárbol
+        std::int32_t firstChild; // los 4 hijos van seguidos; -1 si es hoja
+        Node* node;
+        Bucket* overflow; // cubetas para lo que no entra en el arreglo del nodo
+    };
+    struct BuildTask {
+        Node* node;
+        std::size_t first;
+        std::size_t count;
+        std::vector<BuildNode> nodes;
+        std::size_t allocations;
+    };
+    std::vector<Item> buildItems;
+    std::vector<BuildTask> buildTasks;
+    std::size_t buildTaskCount = 0;
+    // copia de trabajo de partition(): los objetos y el cuadrante de cada uno
+    struct Scratch {
+        std::vector<Item> items;
+        std::vector<std::int8_t> quadrant;
+
+        std::size_t capacity() const { return std::min(items.capacity(), quadrant.capacity()); }
+        void reserve(std::size_t n) {
+            items.reserve(n);
+            quadrant.reserve(n);
+        }
     };
+    std::vector<Scratch> buildScratch; // uno por trabajador
+
+    using Clock = std::chrono::steady_clock;
+    BuildTimes times;
+
+    // ns desde mark, que pasa a ser el instante actual
+    static std::int64_t lap(Clock::time_point& mark) {
+        const Clock::time_point now = Clock::now();
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - mark).count();
+        mark = now;
+        return ns;
+    }
+
+    // sube cada vez que se crean o se juntan nodos; quien dibuja la
+    // cuadrícula la regenera solo cuando cambia
+    std::uint64_t version = 0;
 
     Node* root = nullptr;
     int capacity;
-    sf::FloatRect worldBounds;
+    int maxDepth;
+    Rect worldBounds;
+    ShapeFn shape;
 
-    void clear(Node* node) {
-        if (!node) return;
-        if (node->divided) {
-            clear(node->nw);
-            clear(node->ne);
-            clear(node->sw);
-            clear(node->se);
+    Node& slot(std::size_t i) const { return chunks[i / CHUNK_SIZE][i % CHUNK_SIZE]; }
+
+    // un nodo del pool sin preparar: primero los devueltos por merge(), si no
+    // el siguiente en orden
+    Node* takeNode() {
+        if (!freeNodes.empty()) {
+            Node* node = freeNodes.back();
+            freeNodes.pop_back();
+            return node;
         }
-        delete node;
+        if (nodesUsed == chunks.size() * CHUNK_SIZE) {
+            if (chunks.size() == chunks.capacity()) ++allocations;
+            chunks.emplace_back(new Node[CHUNK_SIZE]);
+            ++allocations;
+            // lugar para devolverlos todos a freeNodes
+            freeNodes.reserve(chunks.size() * CHUNK_SIZE);
+            ++allocations;
+        }
+        return &slot(nodesUsed++);
     }
 
-    bool insert(Node* node, Entity* e) {
-        if (!node) return false;
+    // una cubeta vacía del pool, con el mismo orden que takeNode()
+    Bucket* takeBucket() {
+        Bucket* bucket;
+        if (!freeBuckets.empty()) {
+            bucket = freeBuckets.back();
+            freeBuckets.pop_back();
+        } else {
+            if (bucketsUsed == bucketChunks.size() * CHUNK_SIZE) {
+                if (bucketChunks.size() == bucketChunks.capacity()) ++allocations;
+                bucketChunks.emplace_back(new Bucket[CHUNK_SIZE]);
+                ++allocations;
+                freeBuckets.reserve(bucketChunks.size() * CHUNK_SIZE);
+                ++allocations;
+            }
+            bucket = &bucketChunks[bucketsUsed / CHUNK_SIZE][bucketsUsed % CHUNK_SIZE];
+            ++bucketsUsed;
+        }
+        bucket->count = 0;
+        bucket->next = nullptr;
+        return bucket;
+    }
+
+    // las cubetas de desborde, ya enlazadas, de un nodo que va a recibir own
+    // objetos; nullptr si entran en su arreglo
+    Bucket* takeChain(std::size_t own) {
+        Bucket* head = nullptr;
+        for (std::size_t extra = own > Capacity ? (own - 1) / Capacity : 0; extra > 0; --extra) {
+            Bucket* bucket = takeBucket();
+            bucket->next = head;
+            head = bucket;
+        }
+        return head;
+    }
 
-        if (!node->boundary.contains(e->shape.getPosition()))
-            return false;
+    Node* allocNode(const Rect& bounds, Node* parent) {
+        Node* node = takeNode();
+        initNode(node, bounds, parent);
+        return node;
+    }
 
-        if ((int)node->objects.size() < node->capacity && !node->divided) {
-            node->objects.push_back(e);
-            return true;
+    // la cadena vieja de un nodo reutilizado ya volvió al pool (merge()) o se
+    // rebobinó con él (reset()): no se recorre
+    void initNode(Node* node, const Rect& bounds, Node* parent) {
+        node->boundary = bounds;
+        node->capacity = capacity;
+        node->depth = parent ? parent->depth + 1 : 0;
+        node->divided = false;
+        node->count = 0;
+        node->size = 0;
+        node->objects.count = 0;
+        node->objects.next = nullptr;
+        node->tail = &node->objects;
+        node->parent = parent;
+        node->nw = node->ne = node->sw = node->se = nullptr;
+    }
+
+    // vacía los objetos propios de node y devuelve sus cubetas de desborde
+    void clearObjects(Node* node) {
+        for (Bucket* b = node->objects.next; b;) {
+            Bucket* next = b->next;
+            releaseBucket(b);
+            b = next;
         }
+        node->objects.count = 0;
+        node->objects.next = nullptr;
+        node->tail = &node->objects;
+        node->size = 0;
+    }
+
+    Node* nodeFor(const Id& id) const {
+        const std::size_t i = shape.index(id);
+        return i < nodeOf.size() && nodeOf[i].stamp == stamp ? nodeOf[i].node : nullptr;
+    }
 
-        if (!node->divided) subdivide(node);
+    void remember(const Id& id, Node* node) {
+        if constexpr (INDEXED) nodeOf[shape.index(id)] = {node, stamp};
+    }
 
-        if (insert(node->nw, e)) return true;
-        if (insert(node->ne, e)) return true;
-        if (insert(node->sw, e)) return true;
-        if (insert(node->se, e)) return true;
+    void releaseNode(Node* node) {
+        if (freeNodes.size() == freeNodes.capacity()) ++allocations;
+        freeNodes.push_back(node);
+    }
 
-        return false;
+    void releaseBucket(Bucket* bucket) {
+        if (freeBuckets.size() == freeBuckets.capacity()) ++allocations;
+        freeBuckets.push_back(bucket);
     }
 
-    void subdivide(Node* node) {
-        const float x = node->boundary.position.x;
-        const float y = node->boundary.position.y;
-        const float w = node->boundary.size.x / 2.f;
-        const float h = node->boundary.size.y / 2.f;
+    // push_back que cuenta la reserva si el vector tiene que crecer
+    template <typename U>
+    void pushCounted(std::vector<U>& v, const U& value) const {
+        if (v.size() == v.capacity()) ++allocations;
+        v.push_back(value);
+    }
+
+    void push(Node* node, const Item& item) {
+        Bucket* bucket = node->tail;
+        if (bucket->count == Capacity) {
+            bucket->next = takeBucket();
+            bucket = node->tail = bucket->next;
+        }
+        bucket->set(bucket->count++, item);
+        ++node->size;
+        remember(item.id, node);
+    }
+
+    // borra el objeto i de bucket moviendo a su lugar el último de la cadena;
+    // si la última cubeta de desborde queda vacía vuelve al pool
+    void eraseSwap(Node* node, Bucket* bucket, std::size_t i) {
+        Bucket* last = node->tail;
+        bucket->set(i, (*last)[last->count - 1]);
+        --last->count;
+        --node->size;
+        if (last->count > 0 || last == &node->objects) return;
+        Bucket* prev = &node->objects;
+        while (prev->next != last) prev = prev->next;
+        prev->next = nullptr;
+        node->tail = prev;
+        releaseBucket(last);
+    }
+
+    static void quadrants(const Rect& b, Rect (&quads)[4]) {
+        const float w = b.w / 2.f;
+        const float h = b.h / 2.f;
+        quads[0] = Rect(b.x,     b.y,     w, h);
+        quads[1] = Rect(b.x + w, b.y,     w, h);
+        quads[2] = Rect(b.x,     b.y + h, w, h);
+        quads[3] = Rect(b.x + w, b.y + h, w, h);
+    }
+
+    // hijo que contiene el punto, el mismo que elegiría insert()
+    static Node* childFor(Node* node, const Vec2& pos) {
+        if (node->nw->boundary.contains(pos)) return node->nw;
+        if (node->ne->boundary.contains(pos)) return node->ne;
+        if (node->sw->boundary.contains(pos)) return node->sw;
+        if (node->se->boundary.contains(pos)) return node->se;
+        return nullptr;
+    }
+
+    static bool encloses(const Rect& outer, const Rect& inner) {
+        return inner.x >= outer.x && inner.y >= outer.y &&
+               inner.x + inner.w <= outer.x + outer.w &&
+               inner.y + inner.h <= outer.y + outer.h;
+    }
+
+    // hijo que contiene el círculo completo; nullptr si cruza algún borde
+    static Node* childFitting(Node* node, const Item& item) {
+        Node* child = childFor(node, item.pos);
+        if (child && encloses(child->boundary, item.bounds())) return child;
+        return nullptr;
+    }
 
-        node->nw = new Node(sf::FloatRect({x,      y},      {w, h}), node->capacity);
-        node->ne = new Node(sf::FloatRect({x + w,  y},      {w, h}), node->capacity);
-        node->sw = new Node(sf::FloatRect({x,      y + h},  {w, h}), node->capacity);
-        node->se = new Node(sf::FloatRect({x + w,  y + h},  {w, h}), node->capacity);
+    // intersección exacta círculo / rectángulo
+    static bool overlaps(const Rect& range, float cx, float cy, float r) {
+        if (r <= 0.f) return range.contains({cx, cy});
+
+        const float nx = std::clamp(cx, range.x, range.x + range.w);
+        const float ny = std::clamp(cy, range.y, range.y + range.h);
+        const float dx = cx - nx;
+        const float dy = cy - ny;
+        return dx * dx + dy * dy < r * r;
+    }
+
+    // distancia al cuadrado de p al rectángulo (0 si está dentro)
+    static float distance2(const Rect& r, const Vec2& p) {
+        const float nx = std::clamp(p.x, r.x, r.x + r.w);
+        const float ny = std::clamp(p.y, r.y, r.y + r.h);
+        const float dx = p.x - nx;
+        const float dy = p.y - ny;
+        return dx * dx + dy * dy;
+    }
+
+    // baja por el árbol mientras el círculo quepa en un hijo; los que cruzan
+    // un borde se quedan en el nodo interno. Las hojas en maxDepth no se
+    // dividen: aceptan más de capacity (cubetas de desborde)
+    void place(Node* node, const Item& item) {
+        for (;;) {
+            ++node->count;
+            if (!node->divided) {
+                if (node->size < node->capacity || node->depth >= maxDepth) {
+                    push(node, item);
+                    return;
+                }
+                subdivide(node);
+            }
+
+            Node* child = childFitting(node, item);
+            if (!child) {
+                push(node, item);
+                return;
+            }
+            node = child;
+        }
+    }
+
+    void detach(Node* node, const Id& id) {
+        for (Bucket* b = &node->objects; b; b = b->next) {
+            for (std::size_t i = 0; i < b->count; ++i) {
+                if (!(b->ids[i] == id)) continue;
+                eraseSwap(node, b, i);
+                nodeOf[shape.index(id)].node = nullptr;
+                for (Node* n = node; n; n = n->parent) --n->count;
+                return;
+            }
+        }
+    }
+
+    // junta los hijos en el padre mientras el subárbol quepa en un nodo
+    void merge(Node* node) {
+        while (node && node->divided && node->count <= node->capacity) {
+            ++version;
+            for (Node* child : {node->nw, node->ne, node->sw, node->se}) {
+                for (const Bucket* b = &child->objects; b; b = b->next) {
+                    for (std::size_t i = 0; i < b->count; ++i) push(node, (*b)[i]);
+                }
+                clearObjects(child);
+                releaseNode(child);
+            }
+            node->nw = node->ne = node->sw = node->se = nullptr;
+            node->divided = false;
+            node = node->parent;
+        }
+    }
+
+    void subdivide(Node* node) {
+        ++version;
+        Rect quads[4];
+        quadrants(node->boundary, quads);
+        node->nw = allocNode(quads[0], node);
+        node->ne = allocNode(quads[1], node);
+        node->sw = allocNode(quads[2], node);
+        node->se = allocNode(quads[3], node);
 
         node->divided = true;
 
-        auto oldObjects = node->objects;
-        node->objects.clear();
-        for (auto* obj : oldObjects) {
-            insert(node->nw, obj) || insert(node->ne, obj) ||
-            insert(node->sw, obj) || insert(node->se, obj);
+        // un hijo recibe como mucho `capacity` objetos, asi que place() no
+        // vuelve a subdividir mientras se recorre scratch
+        scratch.clear();
+        for (const Bucket* b = &node->objects; b; b = b->next) {
+            for (std::size_t i = 0; i < b->count; ++i) pushCounted(scratch, (*b)[i]);
+        }
+        clearObjects(node);
+        for (const Item& item : scratch) {
+            if (Node* child = childFitting(node, item))
+                place(child, item);
+            else
+                push(node, item);
+        }
+    }
+
+    // fuera de la raíz cada círculo está entero dentro de su nodo: si toca
+    // el círculo de consulta, el nodo está a menos de radius del centro
+    template <typename F>
+    bool circleQuery(Node* node, const Vec2& c, float radius, F& callback) const {
+        QUADTREE_COUNT(++counters.nodesVisited);
+        QUADTREE_COUNT(counters.entitiesTested += node->size);
+        for (const Bucket* b = &node->objects; b; b = b->next) {
+            for (std::size_t i = 0; i < b->count; ++i) {
+                const float dx = b->xs[i] - c.x;
+                const float dy = b->ys[i] - c.y;
+                const float lim = radius + b->rs[i];
+                if (dx * dx + dy * dy < lim * lim && !emit(callback, b->ids[i])) return false;
+            }
+        }
+
+        if (node->divided) {
+            for (Node* child : {node->nw, node->ne, node->sw, node->se}) {
+                if (distance2(child->boundary, c) <= radius * radius &&
+                    !circleQuery(child, c, radius, callback))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // t de entrada del rayo al rectángulo dentro de [0, maxT] (prueba de slabs)
+    static bool rayEnters(const Rect& r, const Vec2& o, const Vec2& d, float maxT, float& tEnter) {
+        float t0 = 0.f;
+        float t1 = maxT;
+        const float lo[2] = {r.x, r.y};
+        const float hi[2] = {r.x + r.w, r.y + r.h};
+        const float org[2] = {o.x, o.y};
+        const float dir[2] = {d.x, d.y};
+        for (int axis = 0; axis < 2; ++axis) {
+            if (dir[axis] == 0.f) {
+                if (org[axis] < lo[axis] || org[axis] > hi[axis]) return false;
+                continue;
+            }
+            float ta = (lo[axis] - org[axis]) / dir[axis];
+            float tb = (hi[axis] - org[axis]) / dir[axis];
+            if (ta > tb) std::swap(ta, tb);
+            if (ta > t0) t0 = ta;
+            if (tb < t1) t1 = tb;
+            if (t0 > t1) return false;
+        }
+        tEnter = t0;
+        return true;
+    }
+
+    // menor t en [0, maxT] donde el rayo toca el círculo; t = 0 si el origen
+    // ya está dentro
+    static bool rayHitsCircle(const Vec2& o, const Vec2& d, float maxT,
+                              float cx, float cy, float r, float& t) {
+        const float ox = o.x - cx;
+        const float oy = o.y - cy;
+        const float c = ox * ox + oy * oy - r * r;
+        if (c <= 0.f) {
+            t = 0.f;
+            return true;
+        }
+        const float a = d.x * d.x + d.y * d.y;
+        const float b = ox * d.x + oy * d.y; // la mitad del término lineal
+        if (a == 0.f || b >= 0.f) return false; // quieto o alejándose
+        // distancia al centro desde el punto del rayo más cercano, no b² - a·c:
+        // lejos de un círculo chico esa resta se come todos los dígitos
+        const float tc = -b / a;
+        const float px = ox + tc * d.x;
+        const float py = oy + tc * d.y;
+        const float h = r * r - (px * px + py * py);
+        if (h < 0.f) return false;
+        t = std::max(0.f, tc - std::sqrt(h / a));
+        return t <= maxT;
+    }
+
+    // objetos propios primero (pueden estar en cualquier parte del nodo) y
+    // después los hijos en el orden en que los cruza el rayo; un hijo que
+    // empieza más lejos que el mejor impacto ya no se visita
+    void ray(Node* node, const Vec2& o, const Vec2& d, std::optional<RayHit>& best,
+             float& limit) const {
+        QUADTREE_COUNT(++counters.nodesVisited);
+        QUADTREE_COUNT(counters.entitiesTested += node->size);
+        for (const Bucket* b = &node->objects; b; b = b->next) {
+            for (std::size_t i = 0; i < b->count; ++i) {
+                float t;
+                if (!rayHitsCircle(o, d, limit, b->xs[i], b->ys[i], b->rs[i], t)) continue;
+                if (!best || t < best->t || (t == best->t && b->ids[i] < best->id)) {
+                    best = RayHit{b->ids[i], t};
+                    limit = t;
+                }
+            }
+        }
+
+        if (!node->divided) return;
+
+        // a lo sumo 4 hijos: inserción ordenada por t de entrada
+        std::pair<float, Node*> order[4];
+        int count = 0;
+        for (Node* child : {node->nw, node->ne, node->sw, node->se}) {
+            float tEnter;
+            if (!rayEnters(child->boundary, o, d, limit, tEnter)) continue;
+            int k = count++;
+            for (; k > 0 && order[k - 1].first > tEnter; --k) order[k] = order[k - 1];
+            order[k] = {tEnter, child};
+        }
+        for (int k = 0; k < count; ++k) {
+            if (order[k].first > limit) break;
+            ray(order[k].second, o, d, best, limit);
         }
     }
 
-    void query(Node* node, const sf::FloatRect& range, std::vector<Entity*>& found) const {
-        if (!node) return;
+    // ------------ construcción en bloque ------------
 
-        if (!node->boundary.findIntersection(range).has_value())
+    // cuadrante (0 = nw .. 3 = se) donde childFitting() dejaría el círculo; -1
+    // si se queda en el nodo. Los cuadrantes no se solapan: el único que puede
+    // contener el centro sale de compararlo con las mitades, sin recorrer los
+    // cuatro con saltos que el procesador no adivina
+    static int fittingQuadrant(const Rect (&quads)[4], const Item& item) {
+        const int q = (item.pos.x >= quads[1].x) + 2 * (item.pos.y >= quads[2].y);
+        if (!quads[q].contains(item.pos)) return -1;
+        return encloses(quads[q], item.bounds()) ? q : -1;
+    }
+
+    // reordena items[first, first + count) en [propios | nw | ne | sw | se]
+    // sin alterar el orden relativo, que es el orden de inserción
+    static void partition(std::vector<Item>& items, std::size_t first, std::size_t count,
+                          const Rect (&quads)[4], Scratch& tmp, std::size_t (&sizes)[5]) {
+        tmp.items.assign(items.begin() + first, items.begin() + first + count);
+        tmp.quadrant.resize(count);
+        std::fill(std::begin(sizes), std::end(sizes), std::size_t{0});
+        for (std::size_t i = 0; i < count; ++i) {
+            tmp.quadrant[i] = static_cast<std::int8_t>(fittingQuadrant(quads, tmp.items[i]) + 1);
+            ++sizes[tmp.quadrant[i]];
+        }
+
+        std::size_t offset[5];
+        offset[0] = first;
+        for (int k = 1; k < 5; ++k) offset[k] = offset[k - 1] + sizes[k - 1];
+        for (std::size_t i = 0; i < count; ++i) items[offset[tmp.quadrant[i]]++] = tmp.items[i];
+    }
+
+    // niveles superiores en serie, hasta splitDepth; lo que queda debajo se
+    // vuelve una tarea
+    void splitTop(Node* node, std::size_t first, std::size_t count, int depth, int splitDepth) {
+        node->count = static_cast<int>(count);
+        if ((int)count <= node->capacity || depth == splitDepth || depth >= maxDepth) {
+            if (buildTaskCount == buildTasks.size()) {
+                buildTasks.emplace_back();
+                ++allocations;
+            }
+            BuildTask& task = buildTasks[buildTaskCount++];
+            task.node = node;
+            task.first = first;
+            task.count = count;
             return;
+        }
+
+        Rect quads[4];
+        quadrants(node->boundary, quads);
+        std::size_t sizes[5];
+        if (buildScratch[0].capacity() < count) allocations += 2;
+        partition(buildItems, first, count, quads, buildScratch[0], sizes);
+
+        node->nw = allocNode(quads[0], node);
+        node->ne = allocNode(quads[1], node);
+        node->sw = allocNode(quads[2], node);
+        node->se = allocNode(quads[3], node);
+        node->divided = true;
+        for (std::size_t i = first; i < first + sizes[0]; ++i) push(node, buildItems[i]);
+
+        Node* children[4] = {node->nw, node->ne, node->sw, node->se};
+        std::size_t next = first + sizes[0];
+        for (int q = 0; q < 4; ++q) {
+            splitTop(children[q], next, sizes[q + 1], depth + 1, splitDepth);
+            next += sizes[q + 1];
+        }
+    }
+
+    // describe el subárbol de task.nodes[index] con la misma regla que place():
+    // un nodo se divide cuando le llegan más de capacity entidades y no está
+    // en maxDepth
+    void layout(BuildTask& task, std::size_t index, Scratch& tmp, int depth) {
+        const std::size_t first = task.nodes[index].first;
+        const std::size_t count = task.nodes[index].count;
+        if ((int)count <= capacity || depth >= maxDepth) {
+            task.nodes[index].own = count;
+            return;
+        }
+
+        Rect quads[4];
+        quadrants(task.nodes[index].boundary, quads);
+        if (tmp.capacity() < count) task.allocations += 2;
+        std::size_t sizes[5];
+        partition(buildItems, first, count, quads, tmp, sizes);
+
+        const std::size_t child = task.nodes.size();
+        task.nodes[index].own = sizes[0];
+        task.nodes[index].firstChild = static_cast<std::int32_t>(child);
+
+        std::size_t next = first + sizes[0];
+        for (int q = 0; q < 4; ++q) {
+            if (task.nodes.size() == task.nodes.capacity()) ++task.allocations;
+            task.nodes.push_back({quads[q], next, 0, sizes[q + 1], -1, nullptr, nullptr});
+            next += sizes[q + 1];
+        }
+        for (int q = 0; q < 4; ++q) layout(task, child + q, tmp, depth + 1);
+    }
+
+    // llena un nodo recién preparado con buildItems[first, first + own),
+    // pasando a las cubetas de chain a medida que se llena cada una
+    void fill(Node* node, Bucket* chain, std::size_t first, std::size_t own) {
+        Bucket* bucket = &node->objects;
+        for (std::size_t i = first; i < first + own; ++i) {
+            if (bucket->count == Capacity) {
+                bucket->next = chain;
+                bucket = chain;
+                chain = chain->next;
+                bucket->next = nullptr;
+            }
+            bucket->set(bucket->count++, buildItems[i]);
+            remember(buildItems[i].id, node);
+        }
+        node->tail = bucket;
+        node->size = static_cast<int>(own);
+    }
 
-        for (auto* obj : node->objects) {
-            if (range.contains(obj->shape.getPosition()))
-                found.push_back(obj);
+    // el callback de visit() puede devolver void (seguir siempre) o bool
+    // (false corta el recorrido)
+    template <typename F>
+    bool emit(F& callback, const Id& id) const {
+        QUADTREE_COUNT(++counters.entitiesReturned);
+        if constexpr (std::is_void_v<std::invoke_result_t<F&, const Id&>>) {
+            callback(id);
+            return true;
+        } else {
+            return static_cast<bool>(callback(id));
+        }
+    }
+
+    // false si el callback pidió parar
+    template <typename F>
+    bool query(Node* node, const Rect& range, F& callback) const {
+        QUADTREE_COUNT(++counters.nodesVisited);
+        QUADTREE_COUNT(counters.entitiesTested += node->size);
+        for (const Bucket* b = &node->objects; b; b = b->next) {
+            for (std::size_t i = 0; i < b->count; ++i) {
+                if (overlaps(range, b->xs[i], b->ys[i], b->rs[i]) && !emit(callback, b->ids[i]))
+                    return false;
+            }
         }
 
         if (node->divided) {
-            query(node->nw, range, found);
-            query(node->ne, range, found);
-            query(node->sw, range, found);
-            query(node->se, range, found);
+            for (Node* child : {node->nw, node->ne, node->sw, node->se}) {
+                if (child->boundary.intersects(range) && !query(child, range, callback))
+                    return false;
+            }
         }
+        return true;
     }
 
-    void draw(Node* node, sf::RenderWindow& window) const {
-        if (!node) return;
+    // un par solo puede solaparse si ambos están en el mismo nodo o uno es
+    // ancestro del otro: los hijos son disjuntos y cada círculo cabe en el
+    // suyo. La prueba es círculo contra círculo con el kernel vectorizado,
+    // sobre la pila de ancestros que ya está empaquetada
+    template <typename F>
+    static void collidingPairs(Node* node, float scale, Items& stack, bool recurse, F& callback,
+                               PairWork& work) {
+        const std::size_t mark = stack.size();
+        for (const Bucket* b = &node->objects; b; b = b->next) {
+            for (std::size_t i = 0; i < b->count; ++i) {
+                const Id id = b->ids[i];
+                QUADTREE_COUNT(work.tested += stack.size());
+                narrow::forEachOverlap(b->xs[i], b->ys[i], b->rs[i],
+                                       stack.xs.data(), stack.ys.data(), stack.rs.data(),
+                                       stack.size(), scale,
+                                       [&](std::size_t k) { callback(stack.ids[k], id); });
+                if (stack.size() == stack.capacity()) work.allocations += 4;
+                stack.push_back((*b)[i]);
+            }
+        }
 
-        sf::RectangleShape rect;
-        rect.setPosition(node->boundary.position);
-        rect.setSize(node->boundary.size);
-        rect.setFillColor(sf::Color::Transparent);
-        rect.setOutlineThickness(1.f);
-        rect.setOutlineColor(sf::Color(100, 100, 255, 80));
-        window.draw(rect);
+        if (recurse && node->divided) {
+            collidingPairs(node->nw, scale, stack, true, callback, work);
+            collidingPairs(node->ne, scale, stack, true, callback, work);
+            collidingPairs(node->sw, scale, stack, true, callback, work);
+            collidingPairs(node->se, scale, stack, true, callback, work);
+        }
+        stack.resize(mark);
+    }
 
+    // reparte el árbol en tareas: los nodos por encima de splitDepth aportan
+    // solo sus objetos propios y los de splitDepth (u hojas antes) su subárbol
+    void collectTasks(Node* node, int depth, int splitDepth) const {
+        if (pairTasks.size() == pairTasks.capacity()) ++allocations;
+        if (!node->divided || depth == splitDepth) {
+            pairTasks.push_back({node, true});
+            return;
+        }
+        pairTasks.push_back({node, false});
+        collectTasks(node->nw, depth + 1, splitDepth);
+        collectTasks(node->ne, depth + 1, splitDepth);
+        collectTasks(node->sw, depth + 1, splitDepth);
+        collectTasks(node->se, depth + 1, splitDepth);
+    }
+
+    // apila los objetos de los ancestros de node, de la raíz hacia abajo
+    static void pushAncestors(Node* node, Items& stack, PairWork& work) {
+        if (!node->parent) return;
+        pushAncestors(node->parent, stack, work);
+        for (const Bucket* b = &node->parent->objects; b; b = b->next) {
+            for (std::size_t i = 0; i < b->count; ++i) {
+                if (stack.size() == stack.capacity()) work.allocations += 4;
+                stack.push_back((*b)[i]);
+            }
+        }
+    }
+
+    template <typename F>
+    static void visitNodes(const Node* node, F& callback) {
+        callback(node->boundary, node->depth);
         if (node->divided) {
-            draw(node->nw, window);
-            draw(node->ne, window);
-            draw(node->sw, window);
-            draw(node->se, window);
+            visitNodes(node->nw, callback);
+            visitNodes(node->ne, callback);
+            visitNodes(node->sw, callback);
+            visitNodes(node->se, callback);
         }
     }
 
 public:
-    QuadTree(const sf::FloatRect& bounds, int cap = 4)
-        : capacity(cap), worldBounds(bounds) {
-        root = new Node(worldBounds, capacity);
+    QuadTree(const Rect& bounds, int cap = static_cast<int>(Capacity), int depth = MAX_DEPTH,
+             ShapeFn shapeFn = ShapeFn{})
+        : capacity(cap), maxDepth(depth), worldBounds(bounds), shape(std::move(shapeFn)) {
+        root = allocNode(worldBounds, nullptr);
+        scratch.reserve(static_cast<std::size_t>(capacity)); // subdivide() copia ahí una hoja llena
+        ++allocations;
     }
 
-    ~QuadTree() {
-        clear(root);
-    }
+    QuadTree(const QuadTree&) = delete;
+    QuadTree& operator=(const QuadTree&) = delete;
 
+    // de dónde salen el centro y el radio de cada valor (y su índice)
+    const ShapeFn& shapeFn() const { return shape; }
+    ShapeFn& shapeFn() { return shape; }
+
+    // rebobina los pools sin liberar memoria, en O(1): no recorre los valores
     void reset() {
-        clear(root);
-        root = new Node(worldBounds, capacity);
+        ++version;
+        nodesUsed = 0;
+        freeNodes.clear();
+        bucketsUsed = 0;
+        freeBuckets.clear();
+        // cada 2^32 reset() el stamp da la vuelta y hay que limpiar de verdad
+        if (++stamp == 0) {
+            std::fill(nodeOf.begin(), nodeOf.end(), Slot{nullptr, 0});
+            stamp = 1;
+        }
+        root = allocNode(worldBounds, nullptr);
+    }
+
+    // capacidad por nodo y profundidad máxima; valen para los nodos que se
+    // creen desde ahora, asi que conviene llamarlo antes de reset()/build().
+    // Una capacidad mayor que Capacity es válida: las hojas encadenan cubetas
+    void setLimits(int cap, int depth) {
+        capacity = cap > 0 ? cap : 1;
+        maxDepth = depth > 0 ? depth : 0;
+    }
+
+    int capacityLimit() const { return capacity; }
+    int depthLimit() const { return maxDepth; }
+
+    // el círculo se guarda en el nodo más profundo que lo contiene entero;
+    // los valores con el centro fuera del mundo se ignoran
+    void insert(const Id& id, const Vec2& pos, float radius) {
+        if constexpr (INDEXED) {
+            const std::size_t i = shape.index(id);
+            if (i >= nodeOf.size()) {
+                if (nodeOf.capacity() <= i) ++allocations;
+                nodeOf.resize(i + 1, Slot{nullptr, 0});
+            }
+        }
+        if (root->boundary.contains(pos))
+            place(root, {id, pos, radius});
+    }
+
+    void insert(const Id& id) {
+        const Circle c = shape(id);
+        insert(id, c.center, c.radius);
+    }
+
+    // reconstruye con count valores, itemAt(i) para i en [0, count)
+    template <typename F>
+    void build(std::size_t count, F&& itemAt) {
+        reset();
+        for (std::size_t i = 0; i < count; ++i) insert(itemAt(i));
+    }
+
+    // igual que build(count, itemAt), con el mismo árbol como resultado
+    // (mismos nodos y objetos en el mismo orden), pero construido por
+    // partición: los niveles de arriba se reparten en serie y los subárboles
+    // se describen y se llenan en paralelo en el pool
+    template <typename F>
+    void build(std::size_t count, F&& itemAt, ThreadPool& pool) {
+        Clock::time_point mark = Clock::now();
+        reset();
+
+        if (buildItems.capacity() < count) {
+            buildItems.reserve(count);
+            ++allocations;
+        }
+        buildItems.clear();
+        std::size_t slots = nodeOf.size();
+        for (std::size_t i = 0; i < count; ++i) {
+            const Id id = itemAt(i);
+            const Circle c = shape(id);
+            if (!root->boundary.contains(c.center)) continue;
+            buildItems.push_back({id, c.center, c.radius});
+            if constexpr (INDEXED) slots = std::max(slots, shape.index(id) + 1);
+        }
+        if (slots > nodeOf.size()) {
+            if (nodeOf.capacity() < slots) ++allocations;
+            nodeOf.resize(slots, Slot{nullptr, 0});
+        }
+
+        const unsigned threads = pool.size();
+        if (buildScratch.size() < threads) {
+            buildScratch.resize(threads);
+            ++allocations;
+        }
+        int splitDepth = 0;
+        while ((1u << (2 * splitDepth)) < 4u * threads) ++splitDepth;
+
+        buildTaskCount = 0;
+        splitTop(root, 0, buildItems.size(), 0, splitDepth);
+        times.split = lap(mark);
+
+        // cualquier trabajador puede llevarse cualquier tarea y las tareas
+        // cambian de tamaño entre frames: todos los buffers con el lugar del
+        // más grande, asi lo reservado no depende del reparto
+        std::size_t scratchRoom = 0;
+        std::size_t nodesRoom = 0;
+        for (const auto& tmp : buildScratch) scratchRoom = std::max(scratchRoom, tmp.capacity());
+        for (std::size_t t = 0; t < buildTaskCount; ++t)
+            nodesRoom = std::max(nodesRoom, buildTasks[t].nodes.capacity());
+        for (auto& tmp : buildScratch) {
+            if (tmp.capacity() >= scratchRoom) continue;
+            tmp.reserve(scratchRoom);
+            allocations += 2;
+        }
+        for (std::size_t t = 0; t < buildTaskCount; ++t) {
+            if (buildTasks[t].nodes.capacity() >= nodesRoom) continue;
+            buildTasks[t].nodes.reserve(nodesRoom);
+            ++allocations;
+        }
+
+        pool.parallelFor(buildTaskCount, [&](std::size_t t, unsigned w) {
+            BuildTask& task = buildTasks[t];
+            task.allocations = 0;
+            task.nodes.clear();
+            if (task.nodes.capacity() == 0) ++task.allocations;
+            task.nodes.push_back({task.node->boundary, task.first, 0, task.count, -1, task.node, nullptr});
+            layout(task, 0, buildScratch[w], task.node->depth);
+        });
+        times.layout = lap(mark);
+
+        // los pools no son seguros entre hilos: cada BuildNode se lleva en
+        // serie su nodo (la raíz de la tarea ya lo tiene) y las cubetas de
+        // desborde que va a llenar
+        for (std::size_t t = 0; t < buildTaskCount; ++t) {
+            std::vector<BuildNode>& nodes = buildTasks[t].nodes;
+            for (std::size_t i = 0; i < nodes.size(); ++i) {
+                if (i > 0) nodes[i].node = takeNode();
+                nodes[i].overflow = takeChain(nodes[i].own);
+            }
+        }
+        times.nodes = lap(mark);
+
+        // cada tarea prepara y enlaza sus propios nodos; los hijos de un
+        // BuildNode siempre van después de él, asi se preparan antes de llenarse
+        pool.parallelFor(buildTaskCount, [&](std::size_t t, unsigned) {
+            BuildTask& task = buildTasks[t];
+            for (const BuildNode& bn : task.nodes) {
+                Node* node = bn.node;
+                if (bn.firstChild >= 0) {
+                    const BuildNode* kid = &task.nodes[bn.firstChild];
+                    for (int q = 0; q < 4; ++q) initNode(kid[q].node, kid[q].boundary, node);
+                    node->nw = kid[0].node;
+                    node->ne = kid[1].node;
+                    node->sw = kid[2].node;
+                    node->se = kid[3].node;
+                    node->divided = true;
+                }
+                node->count = static_cast<int>(bn.count);
+                fill(node, bn.overflow, bn.first, bn.own);
+            }
+        });
+
+        times.fill = lap(mark);
+
+        for (std::size_t t = 0; t < buildTaskCount; ++t) allocations += buildTasks[t].allocations;
+    }
+
+    const BuildTimes& buildTimes() const { return times; }
+
+    // quita un valor; fusiona los nodos que quedan por debajo de la capacidad
+    bool remove(const Id& id) {
+        static_assert(INDEXED, "remove() necesita ShapeFn::index()");
+        Node* node = nodeFor(id);
+        if (!node) return false;
+        detach(node, id);
+        merge(node->divided ? node : node->parent);
+        return true;
+    }
+
+    // reubica un valor que se movió o cambió de radio; solo toca la
+    // estructura si ya no cabe en su nodo o ahora cabe en uno de sus hijos
+    void update(const Id& id, const Vec2& pos, float radius) {
+        static_assert(INDEXED, "update() necesita ShapeFn::index()");
+        Node* node = nodeFor(id);
+        if (node) {
+            const Item item{id, pos, radius};
+            const bool stays = node->boundary.contains(pos) &&
+                (node == root || encloses(node->boundary, item.bounds()));
+            if (stays && (!node->divided || !childFitting(node, item))) {
+                for (Bucket* b = &node->objects; b; b = b->next) {
+                    for (std::size_t i = 0; i < b->count; ++i) {
+                        if (b->ids[i] == id) b->set(i, item);
+                    }
+                }
+                return;
+            }
+
+            detach(node, id);
+            merge(node->divided ? node : node->parent);
+        }
+        insert(id, pos, radius);
+    }
+
+    void update(const Id& id) {
+        const Circle c = shape(id);
+        update(id, c.center, c.radius);
+    }
+
+    bool contains(const Id& id) const {
+        static_assert(INDEXED, "contains() necesita ShapeFn::index()");
+        return nodeFor(id) != nullptr;
+    }
+
+    // llama a callback(id) por cada valor cuyo círculo se solapa con el
+    // rectángulo, sin reservar memoria. Si callback devuelve bool, false
+    // detiene el recorrido; visit() devuelve false en ese caso.
+    template <typename F>
+    bool visit(const Rect& range, F&& callback) const {
+        QUADTREE_COUNT(++counters.queries);
+        return query(root, range, callback);
+    }
+
+    // igual que visit() pero contra el círculo (center, radius)
+    template <typename F>
+    bool visitCircle(const Vec2& center, float radius, F&& callback) const {
+        QUADTREE_COUNT(++counters.queries);
+        return circleQuery(root, center, radius, callback);
+    }
+
+    // valores cuyo círculo se solapa con el rectángulo
+    void queryRange(const Rect& range, std::vector<Id>& found) const {
+        visit(range, [this, &found](const Id& id) { pushCounted(found, id); });
+    }
+
+    // valores cuyo círculo se solapa con el círculo (center, radius)
+    void queryCircle(const Vec2& center, float radius, std::vector<Id>& found) const {
+        visitCircle(center, radius, [this, &found](const Id& id) { pushCounted(found, id); });
+    }
+
+    // primer valor que toca el segmento origin + t * dir, t en [0, maxT]
+    // (dir no necesita estar normalizado); empates por Id
+    std::optional<RayHit> raycast(const Vec2& origin, const Vec2& dir, float maxT) const {
+        QUADTREE_COUNT(++counters.queries);
+        std::optional<RayHit> best;
+        float limit = maxT;
+        if (maxT >= 0.f) ray(root, origin, dir, best, limit);
+        QUADTREE_COUNT(counters.entitiesReturned += best ? 1 : 0);
+        return best;
     }
 
-    void insert(Entity* e) {
-        insert(root, e);
+    // los k valores con el centro más cerca de point y a lo sumo a maxDist,
+    // del más cercano al más lejano (empates por Id); reemplaza el contenido
+    // de out. Recorre primero los nodos más cercanos y corta en cuanto el
+    // siguiente nodo queda más lejos que el k-ésimo candidato: el centro de
+    // cada círculo está dentro de su nodo, asi que la distancia al
+    // rectángulo es una cota inferior.
+    void nearest(const Vec2& point, std::size_t k, float maxDist, std::vector<Id>& out) const {
+        out.clear();
+        if (k == 0 || maxDist < 0.f) return;
+        QUADTREE_COUNT(++counters.queries);
+
+        const float max2 = maxDist * maxDist;
+        nodeHeap.clear();
+        bestHeap.clear();
+        pushCounted(nodeHeap, NodeDist{distance2(root->boundary, point), root});
+
+        while (!nodeHeap.empty()) {
+            std::pop_heap(nodeHeap.begin(), nodeHeap.end());
+            const NodeDist next = nodeHeap.back();
+            nodeHeap.pop_back();
+
+            if (next.d2 > max2) break;
+            if (bestHeap.size() == k && next.d2 > bestHeap.front().d2) break;
+
+            const Node* node = next.node;
+            QUADTREE_COUNT(++counters.nodesVisited);
+            QUADTREE_COUNT(counters.entitiesTested += node->size);
+
+            for (const Bucket* b = &node->objects; b; b = b->next) {
+                for (std::size_t i = 0; i < b->count; ++i) {
+                    const float dx = b->xs[i] - point.x;
+                    const float dy = b->ys[i] - point.y;
+                    const Candidate c{dx * dx + dy * dy, b->ids[i]};
+                    if (c.d2 > max2) continue;
+                    if (bestHeap.size() < k) {
+                        pushCounted(bestHeap, c);
+                        std::push_heap(bestHeap.begin(), bestHeap.end());
+                    } else if (c < bestHeap.front()) {
+                        std::pop_heap(bestHeap.begin(), bestHeap.end());
+                        bestHeap.back() = c;
+                        std::push_heap(bestHeap.begin(), bestHeap.end());
+                    }
+                }
+            }
+
+            if (node->divided) {
+                for (Node* child : {node->nw, node->ne, node->sw, node->se}) {
+                    pushCounted(nodeHeap, NodeDist{distance2(child->boundary, point), child});
+                    std::push_heap(nodeHeap.begin(), nodeHeap.end());
+                }
+            }
+        }
+
+        std::sort_heap(bestHeap.begin(), bestHeap.end());
+        for (const Candidate& c : bestHeap) pushCounted(out, c.id);
+        QUADTREE_COUNT(counters.entitiesReturned += out.size());
     }
 
-    void queryRange(const sf::FloatRect& range, std::vector<Entity*>& found) const {
-        query(root, range, found);
+    const QueryCounters& queryCounters() const { return counters; }
+    void resetQueryCounters() { counters = QueryCounters{}; }
+
+    // recorre el árbol entero; pensado para depurar y ajustar capacity, no
+    // para cada frame
+    Stats stats() const {
+        Stats st;
+        std::size_t leafDepthSum = 0;
+        std::size_t entityDepthSum = 0;
+
+        std::vector<std::pair<Node*, int>> stack{{root, 0}};
+        while (!stack.empty()) {
+            const auto [node, depth] = stack.back();
+            stack.pop_back();
+
+            const std::size_t own = static_cast<std::size_t>(node->size);
+            ++st.nodes;
+            st.entities += own;
+            entityDepthSum += own * static_cast<std::size_t>(depth);
+            if (depth > st.maxDepth) st.maxDepth = depth;
+
+            if (node->divided) {
+                st.straddlers += own;
+                for (Node* child : {node->nw, node->ne, node->sw, node->se})
+                    stack.push_back({child, depth + 1});
+            } else {
+                ++st.leaves;
+                leafDepthSum += static_cast<std::size_t>(depth);
+                if ((int)own > node->capacity) ++st.overflowLeaves;
+                if (st.leafOccupancy.size() <= own) st.leafOccupancy.resize(own + 1, 0);
+                ++st.leafOccupancy[own];
+            }
+        }
+
+        st.averageLeafDepth = static_cast<double>(leafDepthSum) / st.leaves;
+        if (st.entities > 0)
+            st.averageEntityDepth = static_cast<double>(entityDepthSum) / st.entities;
+        st.entitiesPerLeaf = static_cast<double>(st.entities - st.straddlers) / st.leaves;
+        return st;
     }
 
-    void draw(sf::RenderWindow& window) const {
-        draw(root, window);
+    // recorre el árbol una sola vez y llama a callback(a, b) por cada par cuyos
+    // círculos están a menos de scale * (ra + rb), con scale <= 1; cada par
+    // aparece exactamente una vez. Usa el kernel SIMD de NarrowPhase.h
+    template <typename F>
+    void forEachCollidingPair(float scale, F&& callback) const {
+        ancestors.clear();
+        QUADTREE_COUNT(++counters.pairSearches);
+        auto counted = [&](const Id& a, const Id& b) {
+            QUADTREE_COUNT(++counters.pairsFound);
+            callback(a, b);
+        };
+        PairWork work;
+        collidingPairs(root, scale, ancestors, true, counted, work);
+        QUADTREE_COUNT(counters.pairsTested += work.tested);
+        allocations += work.allocations;
     }
+
+    // los mismos pares que forEachCollidingPair, repartidos por subárboles entre
+    // los hilos del pool; cada trabajador escribe en su propio buffer y al final
+    // se ordenan por (menor, mayor), asi el resultado no depende de los hilos
+    void collectCollidingPairs(float scale, ThreadPool& pool, std::vector<IdPair>& out) const {
+        const unsigned threads = pool.size();
+        int splitDepth = 0;
+        while ((1u << (2 * splitDepth)) < 4u * threads) ++splitDepth;
+
+        pairTasks.clear();
+        collectTasks(root, 0, splitDepth);
+        if (workerStacks.size() < threads) allocations += 3; // pila, buffer y cuenta por trabajador
+        workerStacks.resize(threads);
+        workerPairs.resize(threads);
+        workerWork.assign(threads, PairWork{});
+
+        // cualquier trabajador puede llevarse cualquier tarea: todas las pilas
+        // con el lugar de la más grande (al menos una hoja llena y algunos
+        // que cruzan, 4 * capacity, por nivel) y cada buffer con el de todos
+        // los pares del frame anterior, asi lo reservado no depende del reparto
+        std::size_t stackRoom = 4 * static_cast<std::size_t>(capacity) * static_cast<std::size_t>(maxDepth + 1);
+        for (const Items& stack : workerStacks) stackRoom = std::max(stackRoom, stack.capacity());
+        for (Items& stack : workerStacks) {
+            if (stack.capacity() >= stackRoom) continue;
+            stack.reserve(stackRoom);
+            allocations += 4;
+        }
+        for (auto& buffer : workerPairs) {
+            buffer.clear();
+            if (buffer.capacity() >= out.capacity()) continue;
+            buffer.reserve(out.capacity());
+            ++allocations;
+        }
+
+        pool.parallelFor(pairTasks.size(), [&](std::size_t t, unsigned w) {
+            Items& stack = workerStacks[w];
+            std::vector<IdPair>& buffer = workerPairs[w];
+            PairWork& work = workerWork[w];
+            stack.clear();
+            pushAncestors(pairTasks[t].node, stack, work);
+            auto emit = [&](const Id& a, const Id& b) {
+                if (buffer.size() == buffer.capacity()) ++work.allocations;
+                buffer.emplace_back(a < b ? a : b, a < b ? b : a);
+            };
+            collidingPairs(pairTasks[t].node, scale, stack, pairTasks[t].subtree, emit, work);
+        });
+
+        std::size_t total = 0;
+        for (const auto& buffer : workerPairs) total += buffer.size();
+        out.clear();
+        if (out.capacity() < total) {
+            out.reserve(std::max(2 * total, nodeOf.size())); // al menos un par por entidad
+            ++allocations;
+        }
+        for (const auto& buffer : workerPairs)
+            out.insert(out.end(), buffer.begin(), buffer.end());
+        std::sort(out.begin(), out.end());
+
+        for (const PairWork& work : workerWork) allocations += work.allocations;
+#if QUADTREE_STATS
+        ++counters.pairSearches;
+        counters.pairsFound += out.size();
+        for (const PairWork& work : workerWork) counters.pairsTested += work.tested;
+#endif
+    }
+
+    std::uint64_t structureVersion() const { return version; }
+
+    // callback(boundary, depth) por cada nodo, de la raíz hacia abajo; sirve
+    // para dibujar la cuadrícula con la biblioteca que sea
+    template <typename F>
+    void forEachNode(F&& callback) const {
+        visitNodes(root, callback);
+    }
+
+    // bytes de los nodos vivos y de las cubetas de desborde en uso
+    std::size_t liveNodeBytes() const {
+        return nodeCount() * sizeof(Node) + (bucketsUsed - freeBuckets.size()) * sizeof(Bucket);
+    }
+
+    std::size_t nodeCount() const { return nodesUsed - freeNodes.size(); }
+
+    // reservas de heap acumuladas; en régimen estable no debe crecer entre frames
+    std::size_t heapAllocations() const { return allocations; }
 };
+
+} // namespace qt
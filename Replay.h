@@ -0,0 +1,383 @@
+#pragma once
+#include <cstddef>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <SFML/Graphics.hpp>
+#include "Simulation.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Grabación y repetición exacta de una partida. La Simulation es determinista
+// (generador con semilla, pares ordenados), asi que basta guardar con qué se
+// reinició y, por cada step(), el dt y la dirección del jugador. Formato
+// binario en el orden de bytes de la máquina (little-endian en x86 y ARM):
+//
+//   cabecera (HEADER bytes)
+//     0  "QTRP"          4  u16 versión     6  u8 modo    7  u8 banderas
+//     8  u32 semilla    12  i32 count      16  i32 enemies
+//    20  f32 ancho      24  f32 alto       28  u32 frames
+//    32  u64 checksum del estado final (si Finished)
+//   frames (FRAME bytes cada uno)
+//     0  f32 dt          4  i8 dir.x        5  i8 dir.y
+//
+// Una grabación cortada (el juego se cerró mal) se puede repetir igual: los
+// frames salen del tamaño del archivo, solo falta el checksum para comparar.
+namespace replay {
+
+constexpr char MAGIC[4] = {'Q', 'T', 'R', 'P'};
+constexpr std::uint16_t VERSION = 1;
+constexpr std::size_t HEADER = 40;
+constexpr std::size_t FRAME = 6;
+// tope de count y enemies al leer: muy por encima de cualquier partida del
+// juego o del bench (1M), y una cabecera rota no llega a Simulation::reset
+constexpr std::int32_t MAX_ENTITIES = 1 << 24;
+
+enum Flag : std::uint8_t {
+    Invulnerable = 1 << 0,
+    Finished = 1 << 1 // frames y checksum escritos al cerrar
+};
+
+struct Header {
+    Simulation::Mode mode = Simulation::Mode::Arcade;
+    std::uint8_t flags = 0;
+    unsigned seed = 0;
+    int count = 0;
+    int enemies = 0;
+    float width = 0.f;
+    float height = 0.f;
+    std::uint32_t frames = 0;
+    std::uint64_t checksum = 0;
+};
+
+struct Frame {
+    float dt = 0.f;
+    sf::Vector2f dir;
+};
+
+// la dirección se guarda en un byte por eje; el teclado solo da -1, 0 o 1,
+// pero se cuantiza igual al grabar para que la repetición vea lo mismo
+inline std::int8_t encodeAxis(float v) {
+    const float c = v < -1.f ? -1.f : (v > 1.f ? 1.f : v);
+    return static_cast<std::int8_t>(c * 127.f + (c < 0.f ? -0.5f : 0.5f));
+}
+
+inline float decodeAxis(std::int8_t v) {
+    return v == 127 ? 1.f : (v == -127 ? -1.f : v / 127.f);
+}
+
+inline sf::Vector2f quantize(const sf::Vector2f& dir) {
+    return {decodeAxis(encodeAxis(dir.x)), decodeAxis(encodeAxis(dir.y))};
+}
+
+// FNV-1a del estado que importa para la partida: entidades y jugador
+inline std::uint64_t checksum(const Simulation& sim) {
+    std::uint64_t h = 1469598103934665603ull;
+    auto mix = [&h](const void* data, std::size_t bytes) {
+        const auto* p = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < bytes; ++i) {
+            h ^= p[i];
+            h *= 1099511628211ull;
+        }
+    };
+
+    const EntityStore& store = sim.entities();
+    const std::uint64_t n = store.size();
+    mix(&n, sizeof(n));
+    mix(store.x.data(), n * sizeof(float));
+    mix(store.y.data(), n * sizeof(float));
+    mix(store.vx.data(), n * sizeof(float));
+    mix(store.vy.data(), n * sizeof(float));
+    mix(store.radius.data(), n * sizeof(float));
+    mix(store.stage.data(), n);
+
+    // el jugador solo existe en Arcade; en QuadDebug quedaría el de antes
+    if (sim.mode() != Simulation::Mode::Arcade) return h;
+    const sf::Vector2f player = sim.player().shape.getPosition();
+    const float survival = sim.survivalTime();
+    const std::uint8_t over = sim.gameOver() ? 1 : 0;
+    mix(&player.x, sizeof(float));
+    mix(&player.y, sizeof(float));
+    mix(&survival, sizeof(float));
+    mix(&over, 1);
+    return h;
+}
+
+namespace detail {
+
+template <typename T>
+void put(unsigned char* buffer, std::size_t offset, const T& value) {
+    std::memcpy(buffer + offset, &value, sizeof(T));
+}
+
+template <typename T>
+T get(const unsigned char* buffer, std::size_t offset) {
+    T value;
+    std::memcpy(&value, buffer + offset, sizeof(T));
+    return value;
+}
+
+inline void encodeHeader(const Header& h, unsigned char* b) {
+    std::memcpy(b, MAGIC, 4);
+    put(b, 4, VERSION);
+    put(b, 6, static_cast<std::uint8_t>(h.mode));
+    put(b, 7, h.flags);
+    put(b, 8, static_cast<std::uint32_t>(h.seed));
+    put(b, 12, static_cast<std::int32_t>(h.count));
+    put(b, 16, static_cast<std::int32_t>(h.enemies));
+    put(b, 20, h.width);
+    put(b, 24, h.height);
+    put(b, 28, h.frames);
+    put(b, 32, h.checksum);
+}
+
+} // namespace detail
+
+// ------------------ grabación ------------------
+
+// Escribe una partida: begin() justo después de Simulation::reset(), frame()
+// con lo mismo que se pasa a cada step() y finish() al terminar. frame()
+// devuelve la dirección cuantizada, que es la que hay que pasarle a step()
+class Recorder {
+private:
+    std::FILE* file = nullptr;
+    Header header;
+
+public:
+    Recorder() = default;
+    ~Recorder() { close(); }
+
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+
+    bool recording() const { return file != nullptr; }
+
+    // sobrescribe path; false si no se pudo abrir
+    bool begin(const char* path, const Simulation& sim, unsigned seed, int count, int enemies) {
+        close();
+        file = std::fopen(path, "wb");
+        if (!file) return false;
+
+        header = Header{};
+        header.mode = sim.mode();
+        header.flags = sim.invulnerableMode() ? Invulnerable : 0;
+        header.seed = seed;
+        header.count = count;
+        header.enemies = enemies;
+        header.width = sim.worldSize().x;
+        header.height = sim.worldSize().y;
+
+        unsigned char buffer[HEADER] = {};
+        detail::encodeHeader(header, buffer);
+        std::fwrite(buffer, 1, HEADER, file);
+        return true;
+    }
+
+    sf::Vector2f frame(float dt, const sf::Vector2f& dir) {
+        if (!file) return dir;
+        unsigned char buffer[FRAME];
+        detail::put(buffer, 0, dt);
+        detail::put(buffer, 4, encodeAxis(dir.x));
+        detail::put(buffer, 5, encodeAxis(dir.y));
+        std::fwrite(buffer, 1, FRAME, file);
+        ++header.frames;
+        return quantize(dir);
+    }
+
+    // completa la cabecera con los frames y el checksum del estado final
+    void finish(const Simulation& sim) {
+        if (!file) return;
+        header.flags |= Finished;
+        header.checksum = checksum(sim);
+        unsigned char buffer[HEADER] = {};
+        detail::encodeHeader(header, buffer);
+        std::fseek(file, 0, SEEK_SET);
+        std::fwrite(buffer, 1, HEADER, file);
+        close();
+    }
+
+    // cierra sin checksum (la grabación queda como cortada)
+    void close() {
+        if (file) std::fclose(file);
+        file = nullptr;
+    }
+};
+
+// ------------------ repetición ------------------
+
+// Archivo de solo lectura mapeado en memoria: los frames se leen directo de
+// las páginas del archivo, sin copiarlos, aunque la grabación sea larga
+class MappedFile {
+private:
+    const unsigned char* bytes = nullptr;
+    std::size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const char* path) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+            close();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) {
+            close();
+            return false;
+        }
+        bytes = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (!bytes) {
+            close();
+            return false;
+        }
+        length = static_cast<std::size_t>(size.QuadPart);
+#else
+        const int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* p = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // el mapeo sigue vivo sin el descriptor
+        if (p == MAP_FAILED) return false;
+        bytes = static_cast<const unsigned char*>(p);
+        length = static_cast<std::size_t>(st.st_size);
+#endif
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (bytes) UnmapViewOfFile(bytes);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (bytes) ::munmap(const_cast<unsigned char*>(bytes), length);
+#endif
+        bytes = nullptr;
+        length = 0;
+    }
+
+    const unsigned char* data() const { return bytes; }
+    std::size_t size() const { return length; }
+};
+
+// Lee una grabación y la vuelve a correr sin ventana:
+//
+//   replay::Player rec;
+//   if (!rec.open("partida.qtr")) ...
+//   Simulation sim(rec.header().width, rec.header().height, pool);
+//   rec.start(sim);
+//   for (std::size_t f = 0; f < rec.frames(); ++f) { auto fr = rec.frame(f); sim.step(fr.dt, fr.dir); }
+//   rec.matches(sim);
+class Player {
+private:
+    MappedFile file;
+    Header info;
+    std::size_t frameCount = 0;
+    bool complete = false; // cerrada con finish() y con todos sus frames
+
+public:
+    // false si no existe, no es una grabación de esta versión o trae valores
+    // que no puede haber escrito el Recorder (modo, cantidades, dt)
+    bool open(const char* path) {
+        frameCount = 0;
+        complete = false;
+        if (!file.open(path)) return false;
+        const unsigned char* b = file.data();
+        if (file.size() < HEADER || std::memcmp(b, MAGIC, 4) != 0 ||
+            detail::get<std::uint16_t>(b, 4) != VERSION) {
+            file.close();
+            return false;
+        }
+
+        const std::uint8_t mode = detail::get<std::uint8_t>(b, 6);
+        info.mode = mode == 0 ? Simulation::Mode::QuadDebug : Simulation::Mode::Arcade;
+        info.flags = detail::get<std::uint8_t>(b, 7);
+        info.seed = detail::get<std::uint32_t>(b, 8);
+        info.count = detail::get<std::int32_t>(b, 12);
+        info.enemies = detail::get<std::int32_t>(b, 16);
+        info.width = detail::get<float>(b, 20);
+        info.height = detail::get<float>(b, 24);
+        info.frames = detail::get<std::uint32_t>(b, 28);
+        info.checksum = detail::get<std::uint64_t>(b, 32);
+
+        if (mode > 1 || info.count < 0 || info.count > MAX_ENTITIES || info.enemies < 0 ||
+            info.enemies > MAX_ENTITIES || !(info.width >= 1.f && info.height >= 1.f)) {
+            file.close();
+            return false;
+        }
+
+        const std::size_t stored = (file.size() - HEADER) / FRAME;
+        complete = (info.flags & Finished) && info.frames <= stored;
+        frameCount = complete ? info.frames : stored;
+
+        // step() no acepta un dt negativo, infinito o NaN
+        for (std::size_t i = 0; i < frameCount; ++i) {
+            const float dt = frame(i).dt;
+            if (!(std::isfinite(dt) && dt >= 0.f)) {
+                file.close();
+                frameCount = 0;
+                complete = false;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const Header& header() const { return info; }
+    std::size_t frames() const { return frameCount; }
+    bool hasChecksum() const { return complete; }
+
+    Frame frame(std::size_t i) const {
+        const unsigned char* b = file.data() + HEADER + i * FRAME;
+        Frame f;
+        f.dt = detail::get<float>(b, 0);
+        f.dir = {decodeAxis(detail::get<std::int8_t>(b, 4)),
+                 decodeAxis(detail::get<std::int8_t>(b, 5))};
+        return f;
+    }
+
+    // deja sim igual que al empezar la grabación; sim debe tener el tamaño
+    // de mundo de header()
+    void start(Simulation& sim) const {
+        sim.setInvulnerable((info.flags & Invulnerable) != 0);
+        sim.reset(info.mode, info.seed, info.count, info.enemies);
+    }
+
+    // true si sim terminó igual que la grabación (o si no hay checksum)
+    bool matches(const Simulation& sim) const {
+        return !hasChecksum() || checksum(sim) == info.checksum;
+    }
+};
+
+} // namespace replay
@@ -0,0 +1,537 @@
+#pragma once
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+#include <SFML/Graphics.hpp>
+#include "VectorMath.h"
+#include "Entity.h"
+#include "EntityStore.h"
+#include "EntityQuadTree.h"
+#include "LinearQuadTree.h"
+#include "UniformGrid.h"
+#include "SweepAndPrune.h"
+#include "BroadPhase.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include "TreeTuner.h"
+
+// backend del árbol del modo Arcade (se reconstruye entero cada frame)
+#ifdef QUADTREE_LINEAR
+using ArcadeTree = LinearQuadTree;
+#else
+using ArcadeTree = QuadTree;
+#endif
+
+// Lógica por frame de los dos modos (mover, reconstruir, colisiones, fusiones,
+// aparición de enemigos y muerte del jugador) sin ventana ni teclado: el juego
+// la dibuja y quadtree_bench la corre sin pantalla. Todo el azar sale de un
+// generador con semilla, asi la misma semilla repite la misma partida.
+class Simulation {
+public:
+    enum class Mode {
+        QuadDebug,
+        Arcade
+    };
+
+    // duración de cada fase en el último step(), en nanosegundos
+    struct PhaseTimes {
+        std::int64_t move = 0;    // entidades y jugador
+        std::int64_t spawn = 0;
+        std::int64_t build = 0;   // reconstrucción o actualización del árbol
+        std::int64_t collide = 0; // búsqueda de pares
+        std::int64_t resolve = 0; // marcas o fusiones
+        std::int64_t player = 0;  // muerte del jugador
+        std::int64_t compact = 0; // quitar las absorbidas del store
+        std::int64_t view = 0;    // entidades visibles (ver setView)
+
+        std::int64_t total() const {
+            return move + spawn + build + collide + resolve + player + compact + view;
+        }
+    };
+
+    // reservas de heap del QuadTree del modo en cada fase del último step();
+    // siempre cero con otra fase amplia o con el árbol lineal
+    struct PhaseAllocations {
+        std::size_t move = 0;
+        std::size_t spawn = 0;
+        std::size_t build = 0;
+        std::size_t collide = 0;
+        std::size_t resolve = 0;
+        std::size_t player = 0;
+        std::size_t compact = 0;
+        std::size_t view = 0;
+
+        std::size_t total() const {
+            return move + spawn + build + collide + resolve + player + compact + view;
+        }
+    };
+
+    static constexpr float RADIUS = 6.f;
+    static constexpr int MAX_STAGE = 5;
+    static constexpr float SAFE_RADIUS = 100.f;
+    static constexpr float SPAWN_INTERVAL = 3.f;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    float width;
+    float height;
+    ThreadPool& pool;
+    std::mt19937 rng;
+    Mode current = Mode::QuadDebug;
+
+    EntityStore store;
+
+    // ------------ modo debug ------------
+    QuadTree quadDebug;
+    std::vector<BroadPhase::IdPair> debugPairs;
+
+    // ------------ modo arcade ------------
+    ArcadeTree quadArcade;
+    std::vector<BroadPhase::IdPair> fusionPairs;
+    std::vector<bool> alive;
+    std::vector<bool> grown;
+    Entity playerEntity;
+    sf::Vector2f playerPrev; // posición del jugador al empezar el tick
+    int maxEnemies = 80;
+    bool over = false;
+    bool invulnerable = false;
+    float survival = 0.f;
+    float spawnTimer = 0.f;
+    TreeTuner tuner;
+    bool autoTune = false;
+
+    // ------------ fase amplia ------------
+    // el QuadTree de cada modo o una de las alternativas, que sirven a los dos
+    UniformGrid grid;
+    SweepAndPrune sweep;
+    BroadPhaseOf<QuadTree> debugTreePhase;
+    BroadPhaseOf<ArcadeTree> arcadeTreePhase;
+    BroadPhaseOf<UniformGrid> gridPhase;
+    BroadPhaseOf<SweepAndPrune> sweepPhase;
+    BroadPhaseKind broad = BroadPhaseKind::QuadTree;
+
+    // ------------ vista ------------
+    sf::FloatRect view;                      // tamaño 0 = sin recorte
+    std::vector<BroadPhase::Id> visibleIds;  // índices en store, ordenados
+    std::vector<BroadPhase::Id> absorbed;    // las que compact() quita este tick
+
+    PhaseTimes phase;
+    PhaseAllocations allocs;
+    std::size_t allocMark = 0; // treeAllocations() al cerrar la fase anterior
+    Profiler* profiler = nullptr;
+
+    // ns desde mark, que pasa a ser el instante actual; si hay un perfilador
+    // activo también le llega el intervalo como la fase p. Las reservas del
+    // árbol desde la fase anterior se anotan también en p
+    std::int64_t lap(Clock::time_point& mark, Profiler::Phase p) {
+        const Clock::time_point now = Clock::now();
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - mark).count();
+        if (profiler) profiler->record(p, mark, now);
+        mark = now;
+        countAllocations(p);
+        return static_cast<std::int64_t>(ns);
+    }
+
+    void countAllocations(Profiler::Phase p) {
+        const std::size_t now = treeAllocations();
+        const std::size_t grown = now - allocMark;
+        allocMark = now;
+        switch (p) {
+            case Profiler::Phase::Move: allocs.move += grown; break;
+            case Profiler::Phase::Spawn: allocs.spawn += grown; break;
+            case Profiler::Phase::Build: allocs.build += grown; break;
+            case Profiler::Phase::Collide: allocs.collide += grown; break;
+            case Profiler::Phase::Resolve: allocs.resolve += grown; break;
+            case Profiler::Phase::Player: allocs.player += grown; break;
+            case Profiler::Phase::Compact: allocs.compact += grown; break;
+            case Profiler::Phase::View: allocs.view += grown; break;
+            default: break;
+        }
+    }
+
+    // una llamada por componente, en orden fijo, para que la secuencia del
+    // generador no dependa del compilador
+    sf::Vector2f randomPosition() {
+        const float x = static_cast<float>(rng() % static_cast<unsigned>(width));
+        const float y = static_cast<float>(rng() % static_cast<unsigned>(height));
+        return {x, y};
+    }
+
+    sf::Vector2f randomVelocity(float divisor) {
+        const float vx = (static_cast<int>(rng() % 100) - 50) / divisor;
+        const float vy = (static_cast<int>(rng() % 100) - 50) / divisor;
+        return {vx, vy};
+    }
+
+    sf::Vector2f center() const { return {width / 2.f, height / 2.f}; }
+
+    // enemigo verde fuera de la zona segura del centro
+    void spawnEnemy() {
+        sf::Vector2f pos;
+        do {
+            pos = randomPosition();
+        } while (length(pos - center()) < SAFE_RADIUS);
+        store.add(pos, RADIUS, randomVelocity(80.f), 0);
+    }
+
+    // rebota contra los bordes del mundo
+    void bounce(std::size_t i, float r) {
+        auto& xs = store.x;
+        auto& ys = store.y;
+        auto& vxs = store.vx;
+        auto& vys = store.vy;
+
+        if (xs[i] - r < 0.f) {
+            xs[i] = r;
+            vxs[i] *= -1.f;
+        } else if (xs[i] + r > width) {
+            xs[i] = width - r;
+            vxs[i] *= -1.f;
+        }
+
+        if (ys[i] - r < 0.f) {
+            ys[i] = r;
+            vys[i] *= -1.f;
+        } else if (ys[i] + r > height) {
+            ys[i] = height - r;
+            vys[i] *= -1.f;
+        }
+    }
+
+    void stepDebug(float dt) {
+        Clock::time_point mark = Clock::now();
+
+        auto& flags = store.flags;
+        std::fill(flags.begin(), flags.end(), std::uint8_t{0});
+
+        const float step = 100.f * dt;
+        for (std::size_t i = 0; i < store.size(); ++i) {
+            store.x[i] += store.vx[i] * step;
+            store.y[i] += store.vy[i] * step;
+            bounce(i, RADIUS);
+        }
+        phase.move = lap(mark, Profiler::Phase::Move);
+
+        // el QuadTree solo cambia si alguna entidad sale de su nodo; la
+        // cuadrícula y el barrido se rearman en la primera consulta
+        BroadPhase& phaseEngine = engine();
+        for (std::size_t i = 0; i < store.size(); ++i)
+            phaseEngine.update(static_cast<BroadPhase::Id>(i), store);
+        phaseEngine.flush();
+        phase.build = lap(mark, Profiler::Phase::Build);
+
+        // cada par una sola vez; la distancia < 2 * RADIUS ya la resuelve el
+        // kernel de la fase estrecha
+        phaseEngine.collectCollidingPairs(1.f, pool, debugPairs);
+        phase.collide = lap(mark, Profiler::Phase::Collide);
+
+        for (const auto& pair : debugPairs) {
+            flags[pair.first] |= EntityStore::Colliding;
+            flags[pair.second] |= EntityStore::Colliding;
+        }
+        phase.resolve = lap(mark, Profiler::Phase::Resolve);
+
+        queryView();
+        phase.view = lap(mark, Profiler::Phase::View);
+    }
+
+    void stepArcade(float dt, const sf::Vector2f& playerDir) {
+        playerEntity.colliding = false;
+        if (over) return;
+
+        Clock::time_point mark = Clock::now();
+        survival += dt;
+        spawnTimer += dt;
+
+        // movimiento jugador
+        const float playerSpeed = 200.f;
+        sf::Vector2f ppos = playerEntity.shape.getPosition();
+        ppos += normalize(playerDir) * playerSpeed * dt;
+
+        float pR = playerEntity.shape.getRadius();
+        if (ppos.x - pR < 0.f) ppos.x = pR;
+        if (ppos.x + pR > width) ppos.x = width - pR;
+        if (ppos.y - pR < 0.f) ppos.y = pR;
+        if (ppos.y + pR > height) ppos.y = height - pR;
+        playerEntity.shape.setPosition(ppos);
+        phase.move = lap(mark, Profiler::Phase::Move);
+
+        // generación de nuevos enemigos
+        if (spawnTimer >= SPAWN_INTERVAL && static_cast<int>(store.size()) < maxEnemies) {
+            spawnTimer = 0.f;
+            spawnEnemy();
+        }
+        phase.spawn = lap(mark, Profiler::Phase::Spawn);
+
+        // movimiento enemigos; los grandes van más rápido
+        auto& radii = store.radius;
+        for (std::size_t i = 0; i < store.size(); ++i) {
+            const float r = radii[i];
+            const float step = 100.f * dt * (r / RADIUS);
+            store.x[i] += store.vx[i] * step;
+            store.y[i] += store.vy[i] * step;
+            bounce(i, r);
+        }
+        phase.move += lap(mark, Profiler::Phase::Move);
+
+        BroadPhase& phaseEngine = engine();
+        phaseEngine.build(store, pool);
+        phase.build = lap(mark, Profiler::Phase::Build);
+
+        // los pares se buscan en paralelo y llegan ordenados por índice, asi que
+        // se resuelven en serie siempre en el mismo orden (con cualquier fase amplia)
+        phaseEngine.collectCollidingPairs(0.9f, pool, fusionPairs);
+        phase.collide = lap(mark, Profiler::Phase::Collide);
+
+        alive.assign(store.size(), true);
+        grown.assign(store.size(), false);
+        absorbed.clear();
+        auto& vxs = store.vx;
+        auto& vys = store.vy;
+        auto& stages = store.stage;
+
+        // el de menor índice absorbe al otro
+        for (const auto& pair : fusionPairs) {
+            const std::size_t i = pair.first;
+            const std::size_t j = pair.second;
+            if (!alive[i] || !alive[j]) continue;
+
+            sf::Vector2f pos = store.position(i);
+            sf::Vector2f opos = store.position(j);
+            float r = radii[i];
+            float r2 = radii[j];
+            // se vuelve a comprobar: i pudo crecer por una fusión anterior
+            sf::Vector2f diff = opos - pos;
+            float lim = (r + r2) * 0.9f;
+
+            if (diff.x * diff.x + diff.y * diff.y < lim * lim) {
+                float newArea = r * r + r2 * r2;
+                radii[i] = std::sqrt(newArea);
+
+                store.setPosition(i, (pos + opos) * 0.5f);
+                vxs[i] = (vxs[i] + vxs[j]) * 0.5f;
+                vys[i] = (vys[i] + vys[j]) * 0.5f;
+
+                int newStage = stages[i];
+                if (stages[j] > newStage) newStage = stages[j];
+                if (newStage < MAX_STAGE) newStage += 1;
+                stages[i] = static_cast<std::uint8_t>(newStage);
+
+                alive[j] = false;
+                grown[i] = true;
+                absorbed.push_back(static_cast<BroadPhase::Id>(j));
+            }
+        }
+
+        // en vez de reconstruir: solo se tocan las fusionadas y las absorbidas
+        for (std::size_t i = 0; i < store.size(); ++i) {
+            const auto id = static_cast<BroadPhase::Id>(i);
+            if (!alive[i])
+                phaseEngine.remove(id);
+            else if (grown[i])
+                phaseEngine.update(id, store);
+        }
+        phaseEngine.flush();
+        phase.resolve = lap(mark, Profiler::Phase::Resolve);
+
+        // muerte del jugador (colisión); los índices aún no se compactan.
+        // Basta saber si hay algún enemigo encima: se corta en el primero
+        const bool hit = phaseEngine.anyInCircle(playerEntity.shape.getPosition(), pR);
+        if (hit) {
+            playerEntity.colliding = true;
+            if (!invulnerable) over = true;
+        }
+        phase.player = lap(mark, Profiler::Phase::Player);
+
+        // la fase amplia todavía usa los índices de antes de compactar
+        queryView();
+        phase.view = lap(mark, Profiler::Phase::View);
+
+        store.compact(alive);
+        remapView();
+        phase.compact = lap(mark, Profiler::Phase::Compact);
+
+        // lo que depende de capacity y profundidad: construir, pares,
+        // actualizar tras las fusiones y la consulta del jugador
+        if (autoTune && broad == BroadPhaseKind::QuadTree &&
+            tuner.record(phase.build + phase.collide + phase.resolve + phase.player))
+            applyLimits();
+    }
+
+    // una sola consulta con el rectángulo de la vista; lo de afuera no se
+    // recorre ni se copia para dibujar
+    void queryView() {
+        visibleIds.clear();
+        if (!culling()) return;
+        engine().queryRange(view, visibleIds);
+        std::sort(visibleIds.begin(), visibleIds.end());
+    }
+
+    // tras store.compact(): cada índice baja tantos lugares como absorbidas
+    // había antes que él (las absorbidas ya no estaban en la fase amplia)
+    void remapView() {
+        std::sort(absorbed.begin(), absorbed.end());
+        std::size_t dead = 0;
+        for (BroadPhase::Id& id : visibleIds) {
+            while (dead < absorbed.size() && absorbed[dead] < id) ++dead;
+            id -= static_cast<BroadPhase::Id>(dead);
+        }
+    }
+
+    BroadPhase& engine() {
+        return const_cast<BroadPhase&>(static_cast<const Simulation&>(*this).broadPhase());
+    }
+
+    void applyLimits() {
+        const TreeTuner::Limits& l = tuner.limits();
+        quadArcade.setLimits(l.capacity, l.maxDepth);
+    }
+
+public:
+    Simulation(float worldWidth, float worldHeight, ThreadPool& threadPool)
+        : width(worldWidth), height(worldHeight), pool(threadPool),
+          quadDebug(sf::FloatRect({0.f, 0.f}, {worldWidth, worldHeight}), 4),
+          quadArcade(sf::FloatRect({0.f, 0.f}, {worldWidth, worldHeight}), 4),
+          grid(sf::FloatRect({0.f, 0.f}, {worldWidth, worldHeight})),
+          sweep(sf::FloatRect({0.f, 0.f}, {worldWidth, worldHeight})),
+          debugTreePhase(quadDebug, BroadPhaseKind::QuadTree),
+          arcadeTreePhase(quadArcade, BroadPhaseKind::QuadTree),
+          gridPhase(grid, BroadPhaseKind::Grid),
+          sweepPhase(sweep, BroadPhaseKind::SweepAndPrune) {}
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    // empieza el modo: count entidades en QuadDebug, count enemigos iniciales
+    // (y como mucho enemies en pantalla) en Arcade
+    void reset(Mode mode, unsigned seed, int count, int enemies = 80) {
+        current = mode;
+        rng.seed(seed);
+        store.clear();
+        phase = PhaseTimes{};
+
+        if (mode == Mode::QuadDebug) {
+            for (int i = 0; i < count; ++i) {
+                const sf::Vector2f pos = randomPosition();
+                store.add(pos, RADIUS, randomVelocity(50.f));
+            }
+
+            // la fase amplia guarda índices en store, que no cambian hasta reiniciar
+            engine().build(store, pool);
+            queryView();
+            return;
+        }
+
+        tuner.reset({4, TreeTuner::MAX_DEPTH});
+        applyLimits();
+
+        playerEntity = Entity(EntityKind::Player, center(), RADIUS * 1.5f, sf::Vector2f(0.f, 0.f));
+        playerPrev = center();
+        for (int i = 0; i < count; ++i) spawnEnemy();
+
+        maxEnemies = enemies;
+        over = false;
+        survival = 0.f;
+        spawnTimer = 0.f;
+
+        // el árbol Arcade se arma en cada step(); aquí solo para la primera vista
+        if (culling()) {
+            engine().build(store, pool);
+            queryView();
+        }
+    }
+
+    // avanza un frame; playerDir solo se usa en Arcade y no hace falta normalizarlo
+    void step(float dt, const sf::Vector2f& playerDir = {0.f, 0.f}) {
+        phase = PhaseTimes{};
+        allocs = PhaseAllocations{};
+        allocMark = treeAllocations();
+        // posiciones de partida del tick, para que el dibujo pueda interpolar
+        store.savePrevious();
+        playerPrev = playerEntity.shape.getPosition();
+        if (current == Mode::QuadDebug)
+            stepDebug(dt);
+        else
+            stepArcade(dt, playerDir);
+    }
+
+    // recibe las fases de cada step(); nullptr para ninguno
+    void setProfiler(Profiler* p) { profiler = p; }
+
+    // el jugador sigue chocando pero la partida no termina (benchmarks)
+    void setInvulnerable(bool value) { invulnerable = value; }
+    bool invulnerableMode() const { return invulnerable; }
+
+    // capacity y profundidad del árbol Arcade ajustadas según el costo medido;
+    // apagado (o al encenderlo) vuelve a capacity 4 y profundidad máxima. Las
+    // colisiones no dependen de la forma del árbol, asi que la partida es la
+    // misma con o sin ajuste
+    void setAutoTune(bool value) {
+        autoTune = value;
+        tuner.reset({4, TreeTuner::MAX_DEPTH});
+        applyLimits();
+    }
+
+    bool autoTuning() const { return autoTune; }
+
+    // cambia la fase amplia de los dos modos; la nueva se arma con el estado
+    // actual. Los pares salen ordenados, asi que la partida no cambia (el
+    // ajuste automático solo corre con el QuadTree)
+    void setBroadPhase(BroadPhaseKind kind) {
+        if (kind == broad) return;
+        broad = kind;
+        engine().build(store, pool);
+    }
+
+    BroadPhaseKind broadPhaseKind() const { return broad; }
+
+    // rectángulo del mundo que se va a dibujar: desde el próximo step()
+    // visible() trae las entidades que lo tocan. Tamaño 0 lo apaga (bench)
+    void setView(const sf::FloatRect& rect) { view = rect; }
+    bool culling() const { return view.size.x > 0.f && view.size.y > 0.f; }
+    const std::vector<BroadPhase::Id>& visible() const { return visibleIds; }
+
+    const BroadPhase& broadPhase() const {
+        switch (broad) {
+            case BroadPhaseKind::Grid: return gridPhase;
+            case BroadPhaseKind::SweepAndPrune: return sweepPhase;
+            default:
+                if (current == Mode::QuadDebug) return debugTreePhase;
+                return arcadeTreePhase;
+        }
+    }
+
+    Mode mode() const { return current; }
+    sf::Vector2f worldSize() const { return {width, height}; }
+    const EntityStore& entities() const { return store; }
+    const Entity& player() const { return playerEntity; }
+    sf::Vector2f playerPrevious() const { return playerPrev; }
+    bool gameOver() const { return over; }
+    float survivalTime() const { return survival; }
+    const PhaseTimes& times() const { return phase; }
+    const PhaseAllocations& allocations() const { return allocs; }
+
+    // reservas acumuladas y bytes de los nodos vivos del QuadTree del modo;
+    // cero con otra fase amplia o con el árbol lineal
+    std::size_t treeAllocations() const {
+        if (broad != BroadPhaseKind::QuadTree) return 0;
+        if (current == Mode::QuadDebug) return quadDebug.heapAllocations();
+        if constexpr (std::is_same_v<ArcadeTree, QuadTree>) return quadArcade.heapAllocations();
+        else return 0;
+    }
+
+    std::size_t treeNodeBytes() const {
+        if (broad != BroadPhaseKind::QuadTree) return 0;
+        if (current == Mode::QuadDebug) return quadDebug.liveNodeBytes();
+        if constexpr (std::is_same_v<ArcadeTree, QuadTree>) return quadArcade.liveNodeBytes();
+        else return 0;
+    }
+
+    const QuadTree& debugTree() const { return quadDebug; }
+    const ArcadeTree& arcadeTree() const { return quadArcade; }
+};
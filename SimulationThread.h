@@ -0,0 +1,354 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <SFML/Graphics.hpp>
+#include "Simulation.h"
+#include "GridOverlay.h"
+#include "Replay.h"
+
+// Corre una Simulation a paso fijo en su propio hilo, desacoplada del dibujo.
+// Cada tick se copia a un Snapshot (posiciones, radios, niveles, jugador,
+// HUD). Hay tres Snapshot: el que escribe la simulación, el último publicado
+// y el que está leyendo el dibujo; publicar y tomar solo intercambian índices
+// bajo el mutex, asi ningún hilo espera al otro ni se copia nada entre ellos.
+// Cada Snapshot trae la posición al empezar y al terminar su tick, y el
+// dibujo interpola entre las dos según el tiempo transcurrido desde que se
+// publicó: un tick de latencia a cambio de movimiento suave a cualquier fps.
+// Con record() cada partida se graba (replay::Recorder) en el mismo hilo.
+// Con setView() el Snapshot trae solo las entidades que tocan la vista (una
+// consulta a la fase amplia por tick), asi copiar y dibujar cuesta según lo
+// que hay en pantalla y no según el tamaño del mundo.
+class SimulationThread {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Snapshot {
+        std::uint64_t generation = 0; // sube con cada start()
+        std::uint64_t tick = 0;
+        Clock::time_point published;
+        Simulation::Mode mode = Simulation::Mode::QuadDebug;
+
+        std::vector<float> x, y;   // al terminar el tick
+        std::vector<float> px, py; // al empezar el tick
+        std::vector<float> radius;
+        std::vector<std::uint8_t> stage;
+        std::vector<std::uint8_t> flags;
+        std::size_t total = 0; // entidades en el mundo, visibles o no
+
+        sf::Vector2f player;
+        sf::Vector2f playerPrevious;
+        float playerRadius = 0.f;
+        bool playerColliding = false;
+        bool gameOver = false;
+        float survival = 0.f;
+
+        BroadPhaseKind broadPhase = BroadPhaseKind::QuadTree;
+        bool autoTune = false;
+        int capacity = 0;
+        int maxDepth = 0;
+
+        bool hasGrid = false;  // cuadrícula y stats solo si se pidieron
+        GridOverlay grid;      // se regenera solo si cambió la estructura
+        QuadTree::Stats stats; // solo en QuadDebug con el QuadTree
+
+        std::size_t size() const { return x.size(); }
+
+        // alpha en [0, 1]: 0 = inicio del tick, 1 = final
+        sf::Vector2f position(std::size_t i, float alpha) const {
+            return {px[i] + (x[i] - px[i]) * alpha, py[i] + (y[i] - py[i]) * alpha};
+        }
+
+        sf::Vector2f playerPosition(float alpha) const {
+            return playerPrevious + (player - playerPrevious) * alpha;
+        }
+    };
+
+private:
+    // si la simulación se atrasa más que esto (pausa del SO, depurador), se
+    // descarta el atraso en vez de correr ticks seguidos para alcanzarlo
+    static constexpr int MAX_LAG_TICKS = 5;
+
+    Simulation& sim;
+    const float tick;
+    const Clock::duration tickDuration;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+
+    // ------------ compartido, protegido por mutex ------------
+    Snapshot slots[3];
+    int writeSlot = 0;
+    int readySlot = 1;
+    int readSlot = 2;
+    bool fresh = false; // readySlot tiene algo que el dibujo aún no tomó
+    std::uint64_t generation = 0;
+    Simulation::PhaseTimes pendingTimes; // ticks aún no reportados al perfilador
+    int pendingTicks = 0;
+
+    bool quit = false;
+    bool running = false;
+    bool resetPending = false;
+    Simulation::Mode resetMode = Simulation::Mode::QuadDebug;
+    unsigned resetSeed = 0;
+    int resetCount = 0;
+    int resetEnemies = 0;
+    sf::Vector2f input;
+    bool showGrid = false;
+    bool autoTune = false;
+    BroadPhaseKind broadPhase = BroadPhaseKind::QuadTree;
+    sf::FloatRect view; // tamaño 0 = todo el mundo
+    std::string recordPath; // vacío = sin grabar
+
+    replay::Recorder recorder; // solo lo toca el hilo de la simulación
+    std::thread worker;
+
+    static void accumulate(Simulation::PhaseTimes& sum, const Simulation::PhaseTimes& t) {
+        sum.move += t.move;
+        sum.spawn += t.spawn;
+        sum.build += t.build;
+        sum.collide += t.collide;
+        sum.resolve += t.resolve;
+        sum.player += t.player;
+        sum.compact += t.compact;
+        sum.view += t.view;
+    }
+
+    // dst[k] = src[ids[k]]
+    template <typename T>
+    static void gather(std::vector<T>& dst, const std::vector<T>& src,
+                       const std::vector<BroadPhase::Id>& ids) {
+        dst.resize(ids.size());
+        for (std::size_t k = 0; k < ids.size(); ++k) dst[k] = src[ids[k]];
+    }
+
+    // solo el hilo de la simulación toca slots[writeSlot]
+    void fill(Snapshot& snap, std::uint64_t gen, std::uint64_t tickCount, bool grid) {
+        const EntityStore& store = sim.entities();
+        // las versiones de estructura de cada árbol o fase amplia no se
+        // comparan entre sí: si cambió la fuente, la cuadrícula se rehace
+        if (snap.mode != sim.mode() || snap.broadPhase != sim.broadPhaseKind()) snap.grid.clear();
+        snap.generation = gen;
+        snap.tick = tickCount;
+        snap.mode = sim.mode();
+        snap.broadPhase = sim.broadPhaseKind();
+        snap.total = store.size();
+        if (sim.culling()) {
+            const std::vector<BroadPhase::Id>& ids = sim.visible();
+            gather(snap.x, store.x, ids);
+            gather(snap.y, store.y, ids);
+            gather(snap.px, store.px, ids);
+            gather(snap.py, store.py, ids);
+            gather(snap.radius, store.radius, ids);
+            gather(snap.stage, store.stage, ids);
+            gather(snap.flags, store.flags, ids);
+        } else {
+            snap.x.assign(store.x.begin(), store.x.end());
+            snap.y.assign(store.y.begin(), store.y.end());
+            snap.px.assign(store.px.begin(), store.px.end());
+            snap.py.assign(store.py.begin(), store.py.end());
+            snap.radius.assign(store.radius.begin(), store.radius.end());
+            snap.stage.assign(store.stage.begin(), store.stage.end());
+            snap.flags.assign(store.flags.begin(), store.flags.end());
+        }
+
+        const Entity& player = sim.player();
+        snap.player = player.shape.getPosition();
+        snap.playerPrevious = sim.playerPrevious();
+        snap.playerRadius = player.shape.getRadius();
+        snap.playerColliding = player.colliding;
+        snap.gameOver = sim.gameOver();
+        snap.survival = sim.survivalTime();
+
+        snap.autoTune = sim.autoTuning();
+        snap.capacity = sim.arcadeTree().capacityLimit();
+        snap.maxDepth = sim.arcadeTree().depthLimit();
+
+        snap.hasGrid = grid;
+        if (!grid) return;
+        sim.broadPhase().buildGrid(snap.grid);
+        if (snap.mode == Simulation::Mode::QuadDebug && snap.broadPhase == BroadPhaseKind::QuadTree)
+            snap.stats = sim.debugTree().stats();
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        std::uint64_t gen = 0;
+        std::uint64_t tickCount = 0;
+        Clock::time_point next = Clock::now();
+
+        while (!quit) {
+            if (!running && !resetPending) {
+                wake.wait(lock, [&] { return quit || running || resetPending; });
+                next = Clock::now();
+                continue;
+            }
+
+            const bool doReset = resetPending;
+            resetPending = false;
+            const Simulation::Mode mode = resetMode;
+            const unsigned seed = resetSeed;
+            const int count = resetCount;
+            const int enemies = resetEnemies;
+            const sf::Vector2f dir = input;
+            const bool grid = showGrid;
+            const bool tune = autoTune;
+            const BroadPhaseKind kind = broadPhase;
+            const sf::FloatRect rect = view;
+            const std::string path = doReset ? recordPath : std::string();
+            if (doReset) gen = generation;
+            lock.unlock();
+
+            // el estado recién reiniciado se publica sin avanzar, asi el
+            // dibujo no muestra un frame vacío ni la partida anterior
+            if (kind != sim.broadPhaseKind()) sim.setBroadPhase(kind);
+            sim.setView(rect);
+            if (doReset) {
+                recorder.finish(sim); // la partida anterior termina aquí
+                sim.reset(mode, seed, count, enemies);
+                if (!path.empty() && !recorder.begin(path.c_str(), sim, seed, count, enemies))
+                    std::fprintf(stderr, "no se pudo grabar en %s\n", path.c_str());
+                tickCount = 0;
+            } else {
+                // grabando, la dirección pasa por el mismo redondeo que verá
+                // la repetición
+                sim.step(tick, recorder.frame(tick, dir));
+                ++tickCount;
+            }
+            if (tune != sim.autoTuning()) sim.setAutoTune(tune);
+            fill(slots[writeSlot], gen, tickCount, grid);
+
+            lock.lock();
+            slots[writeSlot].published = Clock::now();
+            std::swap(writeSlot, readySlot);
+            fresh = true;
+            if (!doReset) {
+                accumulate(pendingTimes, sim.times());
+                ++pendingTicks;
+            }
+
+            next += tickDuration;
+            const Clock::time_point now = Clock::now();
+            if (now - next > MAX_LAG_TICKS * tickDuration) next = now;
+            wake.wait_until(lock, next, [&] { return quit || resetPending; });
+        }
+        lock.unlock();
+        recorder.finish(sim);
+    }
+
+public:
+    // tickSeconds: duración fija de cada step(); sim no debe usarse desde
+    // otro hilo mientras exista este objeto
+    SimulationThread(Simulation& simulation, float tickSeconds)
+        : sim(simulation), tick(tickSeconds),
+          tickDuration(std::chrono::duration_cast<Clock::duration>(
+              std::chrono::duration<float>(tickSeconds))) {
+        sim.setProfiler(nullptr); // el perfilador vive en el hilo del dibujo
+        worker = std::thread([this] { run(); });
+    }
+
+    ~SimulationThread() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+        worker.join();
+    }
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    // reinicia la simulación (Simulation::reset) y la deja corriendo
+    void start(Simulation::Mode mode, unsigned seed, int count, int enemies = 80) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            resetPending = true;
+            running = true;
+            resetMode = mode;
+            resetSeed = seed;
+            resetCount = count;
+            resetEnemies = enemies;
+            input = {0.f, 0.f};
+            ++generation;
+        }
+        wake.notify_all();
+    }
+
+    // graba en path cada partida desde el próximo start(), reemplazando la
+    // anterior: queda la última (ver Replay.h)
+    void record(const std::string& path) {
+        std::lock_guard<std::mutex> lock(mutex);
+        recordPath = path;
+    }
+
+    // detiene los ticks (menú) sin perder el estado
+    void pause() {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+
+    // dirección del jugador para los próximos ticks
+    void setInput(const sf::Vector2f& dir) {
+        std::lock_guard<std::mutex> lock(mutex);
+        input = dir;
+    }
+
+    void setShowGrid(bool value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        showGrid = value;
+    }
+
+    void setAutoTune(bool value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        autoTune = value;
+    }
+
+    void setBroadPhase(BroadPhaseKind kind) {
+        std::lock_guard<std::mutex> lock(mutex);
+        broadPhase = kind;
+    }
+
+    // parte del mundo que se va a dibujar, con margen para lo que se mueve
+    // durante un tick; tamaño 0 copia todas las entidades
+    void setView(const sf::FloatRect& rect) {
+        std::lock_guard<std::mutex> lock(mutex);
+        view = rect;
+    }
+
+    // el Snapshot más nuevo de la partida actual, o nullptr si todavía no hay
+    // uno; sigue siendo válido hasta la próxima llamada
+    const Snapshot* acquire() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (fresh) {
+            std::swap(readSlot, readySlot);
+            fresh = false;
+        }
+        const Snapshot& snap = slots[readSlot];
+        return generation != 0 && snap.generation == generation ? &snap : nullptr;
+    }
+
+    // cuánto del tick de snap ya pasó, para interpolar
+    float alpha(const Snapshot& snap) const {
+        const float elapsed = std::chrono::duration<float>(Clock::now() - snap.published).count();
+        return std::clamp(elapsed / tick, 0.f, 1.f);
+    }
+
+    // tiempos de fase sumados de los ticks corridos desde la última llamada;
+    // en ticks, cuántos fueron
+    Simulation::PhaseTimes takeTimes(int* ticks = nullptr) {
+        std::lock_guard<std::mutex> lock(mutex);
+        const Simulation::PhaseTimes times = pendingTimes;
+        if (ticks) *ticks = pendingTicks;
+        pendingTimes = Simulation::PhaseTimes{};
+        pendingTicks = 0;
+        return times;
+    }
+};
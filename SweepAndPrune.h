@@ -0,0 +1,348 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <SFML/Graphics.hpp>
+#include "EntityStore.h"
+#include "NarrowPhase.h"
+#include "ThreadPool.h"
+#include "GridOverlay.h"
+
+// Barrido y poda (sweep and prune) en x: las entidades se ordenan por el
+// borde izquierdo de su círculo y cada una solo se compara con las que
+// empiezan antes de que ella termine. No depende de una división del espacio,
+// asi que los círculos grandes cuestan lo mismo que los chicos. Misma
+// interfaz que LinearQuadTree; build() ordena de una vez, y update() y
+// remove() corrigen en su lugar mientras el orden siga valiendo (una quitada
+// queda con posición infinita) o si no marcan para reordenar en la próxima
+// consulta.
+//
+// El orden se conserva entre builds: de un frame al siguiente las entidades
+// se mueven poco y el orden viejo ya está casi ordenado, asi que basta una
+// pasada de inserción. Si hace falta mover demasiado (muchas altas, o Ids
+// corridos al compactar) se ordena de cero.
+class SweepAndPrune {
+public:
+    using Id = std::uint32_t;
+    using IdPair = std::pair<Id, Id>; // siempre (menor, mayor)
+
+private:
+    // desplazamientos por entidad tolerados en la pasada de inserción
+    static constexpr std::size_t MAX_SHIFTS = 8;
+    static constexpr float GONE = std::numeric_limits<float>::infinity(); // x de las quitadas
+
+    struct Entry {
+        sf::Vector2f pos;
+        float radius;
+        bool present;
+    };
+    std::vector<Entry> entries;
+
+    // estado construido; mutable porque se construye de forma perezosa en las consultas
+    mutable bool dirty = false;
+    mutable std::vector<Id> order;          // Ids por borde izquierdo, se conserva entre builds
+    mutable std::vector<std::uint8_t> seen; // por Id: ya está en order
+    mutable std::vector<float> lefts;       // x - r de order[i]
+    mutable std::vector<std::uint32_t> slotOf; // posición de cada Id en order
+    mutable std::vector<float> xs, ys, radii; // en el mismo orden, listos para el kernel
+    mutable float maxRadius = 0.f;
+    mutable std::size_t fullSorts = 0;
+
+    mutable std::vector<std::vector<IdPair>> workerPairs;
+
+    float leftOf(Id id) const {
+        return entries[id].pos.x - entries[id].radius;
+    }
+
+    // x - r y x + r se redondean por separado: los cortes del barrido se
+    // amplían unos ulps y el kernel hace la prueba exacta
+    static float slack(float x) {
+        return (std::abs(x) + 1.f) * 1e-6f;
+    }
+
+    void build() const {
+        dirty = false;
+
+        // se quitan los que ya no están y se agregan los nuevos al final
+        seen.assign(entries.size(), 0);
+        std::size_t kept = 0;
+        for (Id id : order) {
+            if (id < entries.size() && entries[id].present && !seen[id]) {
+                seen[id] = 1;
+                order[kept++] = id;
+            }
+        }
+        order.resize(kept);
+        for (Id id = 0; id < entries.size(); ++id) {
+            if (entries[id].present && !seen[id]) order.push_back(id);
+        }
+
+        const std::size_t n = order.size();
+        lefts.resize(n);
+        for (std::size_t i = 0; i < n; ++i) lefts[i] = leftOf(order[i]);
+
+        // inserción con tope; empates por Id para que el orden sea único
+        const std::size_t budget = MAX_SHIFTS * n;
+        std::size_t shifts = 0;
+        for (std::size_t i = 1; i < n && shifts <= budget; ++i) {
+            const Id id = order[i];
+            const float key = lefts[i];
+            std::size_t j = i;
+            while (j > 0 && (lefts[j - 1] > key || (lefts[j - 1] == key && order[j - 1] > id))) {
+                order[j] = order[j - 1];
+                lefts[j] = lefts[j - 1];
+                --j;
+                ++shifts;
+            }
+            order[j] = id;
+            lefts[j] = key;
+        }
+        if (shifts > budget) {
+            std::sort(order.begin(), order.end(), [this](Id a, Id b) {
+                const float la = leftOf(a);
+                const float lb = leftOf(b);
+                return la < lb || (la == lb && a < b);
+            });
+            for (std::size_t i = 0; i < n; ++i) lefts[i] = leftOf(order[i]);
+            ++fullSorts;
+        }
+
+        xs.resize(n);
+        ys.resize(n);
+        radii.resize(n);
+        slotOf.resize(entries.size());
+        maxRadius = 0.f;
+        for (std::size_t i = 0; i < n; ++i) {
+            slotOf[order[i]] = static_cast<std::uint32_t>(i);
+            const Entry& e = entries[order[i]];
+            xs[i] = e.pos.x;
+            ys[i] = e.pos.y;
+            radii[i] = e.radius;
+            maxRadius = std::max(maxRadius, e.radius);
+        }
+    }
+
+    void ensureBuilt() const {
+        if (dirty) build();
+    }
+
+    // cambia la entidad sin reordenar si su borde izquierdo sigue entre los
+    // de sus vecinos; false si hay que reordenar
+    bool patch(Id id, const sf::Vector2f& pos, float radius) {
+        if (dirty || id >= slotOf.size() || !entries[id].present) return false;
+        const std::uint32_t slot = slotOf[id];
+        const float left = pos.x - radius;
+        if ((slot > 0 && lefts[slot - 1] > left) ||
+            (slot + 1 < lefts.size() && lefts[slot + 1] < left))
+            return false;
+        lefts[slot] = left;
+        xs[slot] = pos.x;
+        ys[slot] = pos.y;
+        radii[slot] = radius;
+        maxRadius = std::max(maxRadius, radius);
+        return true;
+    }
+
+    // intersección exacta círculo / rectángulo
+    static bool overlaps(const sf::FloatRect& range, const sf::Vector2f& c, float r) {
+        if (r <= 0.f) return range.contains(c);
+        const float nx = std::clamp(c.x, range.position.x, range.position.x + range.size.x);
+        const float ny = std::clamp(c.y, range.position.y, range.position.y + range.size.y);
+        const float dx = c.x - nx;
+        const float dy = c.y - ny;
+        return dx * dx + dy * dy < r * r;
+    }
+
+    // el callback puede devolver void (seguir siempre) o bool (false corta)
+    template <typename F>
+    static bool emit(F& callback, Id id) {
+        if constexpr (std::is_void_v<std::invoke_result_t<F&, Id>>) {
+            callback(id);
+            return true;
+        } else {
+            return static_cast<bool>(callback(id));
+        }
+    }
+
+    // recorre las entidades cuyo intervalo en x puede tocar [x0, x1]: el
+    // borde izquierdo está en [x0 - 2 * maxRadius, x1]
+    template <typename F>
+    bool forEachInSpan(float x0, float x1, F&& callback) const {
+        const float lo = x0 - 2.f * maxRadius;
+        const float hi = x1 + slack(x1);
+        const auto first = std::lower_bound(lefts.begin(), lefts.end(), lo - slack(lo));
+        for (std::size_t i = static_cast<std::size_t>(first - lefts.begin());
+             i < lefts.size() && lefts[i] <= hi; ++i) {
+            if (!callback(i)) return false;
+        }
+        return true;
+    }
+
+    // pares de [first, last) con los que empiezan después y antes de que
+    // terminen; el tramo de candidatos es contiguo y va entero al kernel
+    template <typename F>
+    void pairsFrom(std::size_t first, std::size_t last, float scale, F& callback) const {
+        for (std::size_t i = first; i < last; ++i) {
+            if (xs[i] == GONE) continue;
+            const float right = xs[i] + radii[i] + slack(xs[i]);
+            const std::size_t begin = i + 1;
+            const std::size_t end = static_cast<std::size_t>(
+                std::lower_bound(lefts.begin() + begin, lefts.end(), right) - lefts.begin());
+            if (begin >= end) continue;
+            narrow::forEachOverlap(xs[i], ys[i], radii[i],
+                                   xs.data() + begin, ys.data() + begin, radii.data() + begin,
+                                   end - begin, scale,
+                                   [&](std::size_t k) { callback(order[i], order[begin + k]); });
+        }
+    }
+
+public:
+    // el barrido no necesita los límites del mundo; se reciben igual que en
+    // los árboles para poder intercambiarlos
+    explicit SweepAndPrune(const sf::FloatRect&) {}
+
+    void reset() {
+        entries.clear();
+        dirty = true;
+    }
+
+    // la construcción se difiere hasta la primera consulta
+    void insert(Id id, const sf::Vector2f& pos, float radius) {
+        if (id >= entries.size()) entries.resize(id + 1, {{0.f, 0.f}, 0.f, false});
+        entries[id] = {pos, radius, true};
+        dirty = true;
+    }
+
+    void insert(Id id, const EntityStore& store) {
+        insert(id, store.position(id), store.radius[id]);
+    }
+
+    // reconstruye con todas las entidades del store (Id = índice)
+    void build(const EntityStore& store) {
+        entries.resize(store.size());
+        for (std::size_t i = 0; i < store.size(); ++i)
+            entries[i] = {store.position(i), store.radius[i], true};
+        build();
+    }
+
+    // misma interfaz que QuadTree::build(store, pool); el orden se arregla
+    // en serie
+    void build(const EntityStore& store, ThreadPool&) {
+        build(store);
+    }
+
+    void update(Id id, const sf::Vector2f& pos, float radius) {
+        if (patch(id, pos, radius))
+            entries[id] = {pos, radius, true};
+        else
+            insert(id, pos, radius);
+    }
+
+    void update(Id id, const EntityStore& store) {
+        update(id, store.position(id), store.radius[id]);
+    }
+
+    bool remove(Id id) {
+        if (!contains(id)) return false;
+        if (!dirty) {
+            xs[slotOf[id]] = GONE;
+            ys[slotOf[id]] = GONE;
+        }
+        entries[id].present = false;
+        return true;
+    }
+
+    // arma ya lo que update()/remove() dejaron pendiente, para que su costo
+    // se mida donde se causó y no en la próxima consulta
+    void flush() const {
+        ensureBuilt();
+    }
+
+    bool contains(Id id) const {
+        return id < entries.size() && entries[id].present;
+    }
+
+    // llama a callback(id) por cada entidad que toca el rectángulo; si
+    // callback devuelve bool, false detiene el recorrido
+    template <typename F>
+    bool visit(const sf::FloatRect& range, F&& callback) const {
+        ensureBuilt();
+        return forEachInSpan(range.position.x, range.position.x + range.size.x,
+                             [&](std::size_t i) {
+                                 return !overlaps(range, {xs[i], ys[i]}, radii[i]) ||
+                                        emit(callback, order[i]);
+                             });
+    }
+
+    // igual que visit() pero contra el círculo (center, radius)
+    template <typename F>
+    bool visitCircle(const sf::Vector2f& center, float radius, F&& callback) const {
+        ensureBuilt();
+        return forEachInSpan(center.x - radius, center.x + radius, [&](std::size_t i) {
+            const float dx = xs[i] - center.x;
+            const float dy = ys[i] - center.y;
+            const float lim = radius + radii[i];
+            return dx * dx + dy * dy >= lim * lim || emit(callback, order[i]);
+        });
+    }
+
+    void queryRange(const sf::FloatRect& range, std::vector<Id>& found) const {
+        visit(range, [&found](Id id) { found.push_back(id); });
+    }
+
+    void queryCircle(const sf::Vector2f& center, float radius, std::vector<Id>& found) const {
+        visitCircle(center, radius, [&found](Id id) { found.push_back(id); });
+    }
+
+    // solo los pares cuyos círculos están a menos de scale * (ra + rb), con scale <= 1
+    template <typename F>
+    void forEachCollidingPair(float scale, F&& callback) const {
+        ensureBuilt();
+        pairsFrom(0, order.size(), scale, callback);
+    }
+
+    // los mismos pares repartidos por tramos del barrido entre los hilos del
+    // pool y ordenados por (menor, mayor): el resultado no depende de los hilos
+    void collectCollidingPairs(float scale, ThreadPool& pool, std::vector<IdPair>& out) const {
+        ensureBuilt();
+        out.clear();
+        const std::size_t n = order.size();
+        if (n == 0) return;
+
+        const unsigned threads = pool.size();
+        workerPairs.resize(threads);
+        for (auto& buffer : workerPairs) buffer.clear();
+
+        const std::size_t tasks = threads > 1 ? 4u * threads : 1u;
+        const std::size_t chunk = (n + tasks - 1) / tasks;
+        pool.parallelFor(tasks, [&](std::size_t t, unsigned w) {
+            std::vector<IdPair>& buffer = workerPairs[w];
+            auto emitPair = [&](Id a, Id b) {
+                buffer.emplace_back(a < b ? a : b, a < b ? b : a);
+            };
+            const std::size_t first = std::min(n, t * chunk);
+            pairsFrom(first, std::min(n, first + chunk), scale, emitPair);
+        });
+
+        for (const auto& buffer : workerPairs)
+            out.insert(out.end(), buffer.begin(), buffer.end());
+        std::sort(out.begin(), out.end());
+    }
+
+    // builds que tuvieron que ordenar de cero en vez de la pasada de inserción
+    std::size_t fullSortCount() const { return fullSorts; }
+
+    // sin celdas ni nodos que dibujar: la cuadrícula queda vacía
+    void buildGrid(GridOverlay& out) const {
+        if (out.upToDate(0)) return;
+        out.clear();
+        out.finish(0);
+    }
+
+    void draw(sf::RenderWindow&) const {}
+};
@@ -0,0 +1,133 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+// Pool de hilos con robo de trabajo: cada hilo tiene su cola de tareas, saca
+// del final de la propia y, cuando se vacía, roba del principio de las demás.
+// El hilo que llama a parallelFor() participa como trabajador 0. Con un solo
+// hilo no se crea ninguno y todo corre en serie en el llamador.
+class ThreadPool {
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::size_t> tasks;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<Queue>> queues;
+
+    std::function<void(std::size_t, unsigned)> job;
+    std::atomic<std::size_t> remaining{0};
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::uint64_t generation = 0;
+    bool stopping = false;
+
+    bool popLocal(unsigned w, std::size_t& task) {
+        Queue& q = *queues[w];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) return false;
+        task = q.tasks.back();
+        q.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(unsigned w, std::size_t& task) {
+        const unsigned n = size();
+        for (unsigned k = 1; k < n; ++k) {
+            Queue& q = *queues[(w + k) % n];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty()) continue;
+            task = q.tasks.front();
+            q.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void runTasks(unsigned w) {
+        std::size_t task;
+        while (popLocal(w, task) || steal(w, task)) {
+            job(task, w);
+            if (remaining.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(mutex);
+                done.notify_all();
+            }
+        }
+    }
+
+    void workerLoop(unsigned w) {
+        std::uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+            runTasks(w);
+        }
+    }
+
+public:
+    explicit ThreadPool(unsigned threads = 1) {
+        if (threads == 0) threads = 1;
+        for (unsigned i = 0; i < threads; ++i)
+            queues.emplace_back(new Queue);
+        for (unsigned i = 1; i < threads; ++i)
+            workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : workers) t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(queues.size()); }
+
+    // ejecuta fn(tarea, trabajador) para cada tarea en [0, count) y espera a
+    // que terminen todas; trabajador está en [0, size())
+    template <typename F>
+    void parallelFor(std::size_t count, F&& fn) {
+        if (size() == 1 || count <= 1) {
+            for (std::size_t t = 0; t < count; ++t) fn(t, 0u);
+            return;
+        }
+
+        job = [&fn](std::size_t t, unsigned w) { fn(t, w); };
+        remaining.store(count);
+        for (std::size_t t = 0; t < count; ++t) {
+            Queue& q = *queues[t % size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            q.tasks.push_back(t);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++generation;
+        }
+        wake.notify_all();
+
+        runTasks(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return remaining.load() == 0; });
+    }
+};
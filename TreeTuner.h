@@ -0,0 +1,117 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+// Ajusta en tiempo de ejecución la capacidad por nodo y la profundidad máxima
+// de un árbol que se reconstruye cada frame, según lo que cuesta de verdad
+// (construcción + consultas). Búsqueda por coordenadas: mide la configuración
+// actual durante WINDOW frames, prueba sus vecinos (capacidad x2 o /2,
+// profundidad +-2) y se mueve al primero que baje la mediana al menos MARGIN.
+// Cuando ningún vecino mejora se queda quieto y vuelve a probar cada RETRY
+// ventanas, por si cambió la carga.
+class TreeTuner {
+public:
+    struct Limits {
+        int capacity;
+        int maxDepth;
+    };
+
+    static constexpr int WINDOW = 30;       // frames por medición
+    static constexpr int RETRY = 20;        // ventanas quieto antes de volver a explorar
+    static constexpr double MARGIN = 0.05;  // mejora mínima para cambiar
+    static constexpr int MIN_CAPACITY = 1;
+    static constexpr int MAX_CAPACITY = 64;
+    static constexpr int MIN_DEPTH = 4;
+    static constexpr int MAX_DEPTH = 16;
+    static constexpr int DEPTH_STEP = 2;
+
+private:
+    Limits current{4, MAX_DEPTH};
+    Limits base{4, MAX_DEPTH}; // la mejor conocida; current es base o un vecino
+    double baseCost = 0.0;     // mediana de base; 0 = sin medir
+
+    std::array<std::int64_t, WINDOW> samples{};
+    int sampleCount = 0;
+
+    int neighbor = -1; // vecino de base que se está midiendo; -1 = midiendo base
+    int idle = 0;      // ventanas seguidas sin explorar
+
+    static bool valid(const Limits& l) {
+        return l.capacity >= MIN_CAPACITY && l.capacity <= MAX_CAPACITY &&
+               l.maxDepth >= MIN_DEPTH && l.maxDepth <= MAX_DEPTH;
+    }
+
+    // vecino k de base (0..3); false si se sale del rango
+    bool neighborOf(int k, Limits& out) const {
+        out = base;
+        switch (k) {
+        case 0: out.capacity *= 2; break;
+        case 1: out.capacity /= 2; break;
+        case 2: out.maxDepth -= DEPTH_STEP; break;
+        default: out.maxDepth += DEPTH_STEP; break;
+        }
+        return valid(out);
+    }
+
+    // siguiente vecino válido desde k; -1 si no queda ninguno
+    int nextNeighbor(int k, Limits& out) const {
+        for (; k < 4; ++k) {
+            if (neighborOf(k, out)) return k;
+        }
+        return -1;
+    }
+
+    double median() {
+        auto mid = samples.begin() + sampleCount / 2;
+        std::nth_element(samples.begin(), mid, samples.begin() + sampleCount);
+        return static_cast<double>(*mid);
+    }
+
+public:
+    TreeTuner() = default;
+    explicit TreeTuner(const Limits& start) { reset(start); }
+
+    // empieza de nuevo desde start (se ajusta al rango)
+    void reset(const Limits& start) {
+        base.capacity = std::clamp(start.capacity, MIN_CAPACITY, MAX_CAPACITY);
+        base.maxDepth = std::clamp(start.maxDepth, MIN_DEPTH, MAX_DEPTH);
+        current = base;
+        baseCost = 0.0;
+        sampleCount = 0;
+        neighbor = -1;
+        idle = 0;
+    }
+
+    const Limits& limits() const { return current; }
+
+    // costo (ns) de un frame construido con limits(); true si limits() cambió
+    // y el árbol debe usar los nuevos valores desde el próximo build
+    bool record(std::int64_t ns) {
+        samples[sampleCount++] = ns;
+        if (sampleCount < WINDOW) return false;
+        const double cost = median();
+        sampleCount = 0;
+
+        if (neighbor < 0) {
+            // base recién medida: se explora ya o tras RETRY ventanas quieto
+            const bool first = baseCost == 0.0;
+            baseCost = cost;
+            if (!first && ++idle < RETRY) return false;
+            idle = 0;
+        } else if (cost < baseCost * (1.0 - MARGIN)) {
+            // el vecino gana: pasa a ser la base y se exploran sus vecinos
+            base = current;
+            baseCost = cost;
+            neighbor = -1;
+        } else {
+            ++neighbor;
+        }
+
+        Limits next;
+        neighbor = nextNeighbor(neighbor < 0 ? 0 : neighbor, next);
+        const Limits previous = current;
+        current = neighbor < 0 ? base : next;
+        return current.capacity != previous.capacity || current.maxDepth != previous.maxDepth;
+    }
+};
@@ -0,0 +1,404 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <SFML/Graphics.hpp>
+#include "EntityStore.h"
+#include "NarrowPhase.h"
+#include "ThreadPool.h"
+#include "GridOverlay.h"
+
+// Cuadrícula uniforme: cada entidad cae en la celda de su centro y las celdas
+// se guardan en un solo arreglo ordenado por celda (conteo + prefijos, sin
+// listas por celda). Misma interfaz que LinearQuadTree. build() arma todo de
+// una vez; update() y remove() corrigen en su lugar si la entidad no cambia de
+// celda (una quitada queda con posición infinita, que ninguna prueba acepta)
+// y si no marcan para rearmar en la próxima consulta.
+//
+// Una consulta mira las celdas a menos del radio máximo del rango, asi que
+// rinde con radios parecidos (modo QuadDebug) y empeora cuando las fusiones
+// crean círculos mucho más grandes que el resto.
+class UniformGrid {
+public:
+    using Id = std::uint32_t;
+    using IdPair = std::pair<Id, Id>; // siempre (menor, mayor)
+
+    // entidades por celda que se buscan con el tamaño automático
+    static constexpr float PER_CELL = 2.f;
+
+private:
+    static constexpr int MAX_CELLS_PER_AXIS = 4096;
+    static constexpr float GONE = std::numeric_limits<float>::infinity(); // x de las quitadas
+
+    sf::FloatRect worldBounds;
+    float cellHint; // 0 = tamaño automático en cada build
+
+    struct Entry {
+        sf::Vector2f pos;
+        float radius;
+        bool present;
+    };
+    std::vector<Entry> entries;
+
+    // estado construido; mutable porque se construye de forma perezosa en las consultas
+    mutable bool dirty = false;
+    mutable float cell = 1.f;
+    mutable int cols = 1;
+    mutable int rows = 1;
+    mutable std::vector<std::uint32_t> cellStart; // cols * rows + 1 prefijos
+    mutable std::vector<std::uint32_t> cellOf;    // celda de cada entrada presente
+    mutable std::vector<Id> items;
+    mutable std::vector<std::uint32_t> slotOf; // posición de cada Id en items
+    mutable std::vector<float> xs, ys, radii; // ordenados por celda, listos para el kernel
+    mutable float maxRadius = 0.f;
+
+    // celdas ocupadas: version solo sube cuando cambian (o cambia el tamaño
+    // de celda) entre dos build()
+    mutable std::vector<std::uint32_t> occupied, occupiedTmp;
+    mutable float occupiedCell = 0.f;
+    mutable std::uint64_t version = 0;
+    mutable GridOverlay grid;
+
+    mutable std::vector<std::vector<IdPair>> workerPairs;
+
+    int cellX(float x) const {
+        const int c = static_cast<int>((x - worldBounds.position.x) / cell);
+        return std::clamp(c, 0, cols - 1);
+    }
+
+    int cellY(float y) const {
+        const int c = static_cast<int>((y - worldBounds.position.y) / cell);
+        return std::clamp(c, 0, rows - 1);
+    }
+
+    // el tamaño de celda sale del radio medio y de la densidad: celdas de al
+    // menos dos diámetros y con unas PER_CELL entidades cada una
+    void chooseCell(std::size_t n, float meanRadius) const {
+        const float w = std::max(worldBounds.size.x, 1.f);
+        const float h = std::max(worldBounds.size.y, 1.f);
+        float size = cellHint;
+        if (size <= 0.f) {
+            const float byDensity = n > 0 ? std::sqrt(w * h * PER_CELL / static_cast<float>(n)) : w;
+            size = std::max(4.f * meanRadius, byDensity);
+        }
+        size = std::max({size, w / MAX_CELLS_PER_AXIS, h / MAX_CELLS_PER_AXIS});
+        cell = size;
+        cols = std::max(1, static_cast<int>(std::ceil(w / size)));
+        rows = std::max(1, static_cast<int>(std::ceil(h / size)));
+    }
+
+    // orden por celda con conteo: las entidades de una celda quedan por Id
+    void build() const {
+        dirty = false;
+
+        std::size_t n = 0;
+        float sum = 0.f;
+        maxRadius = 0.f;
+        for (const Entry& e : entries) {
+            if (!e.present) continue;
+            ++n;
+            sum += e.radius;
+            maxRadius = std::max(maxRadius, e.radius);
+        }
+        chooseCell(n, n > 0 ? sum / static_cast<float>(n) : 0.f);
+
+        const std::size_t cells = static_cast<std::size_t>(cols) * rows;
+        cellStart.assign(cells + 1, 0);
+        cellOf.resize(n);
+        std::size_t k = 0;
+        for (const Entry& e : entries) {
+            if (!e.present) continue;
+            const std::uint32_t c = static_cast<std::uint32_t>(cellY(e.pos.y)) * cols + cellX(e.pos.x);
+            cellOf[k++] = c;
+            ++cellStart[c + 1];
+        }
+        for (std::size_t c = 0; c < cells; ++c) cellStart[c + 1] += cellStart[c];
+
+        items.resize(n);
+        slotOf.resize(entries.size());
+        xs.resize(n);
+        ys.resize(n);
+        radii.resize(n);
+        occupiedTmp.clear();
+        {
+            // cellStart[c] avanza mientras se reparte; después se restaura
+            k = 0;
+            for (Id id = 0; id < entries.size(); ++id) {
+                const Entry& e = entries[id];
+                if (!e.present) continue;
+                const std::uint32_t slot = cellStart[cellOf[k++]]++;
+                items[slot] = id;
+                slotOf[id] = slot;
+                xs[slot] = e.pos.x;
+                ys[slot] = e.pos.y;
+                radii[slot] = e.radius;
+            }
+            for (std::size_t c = cells; c > 0; --c) cellStart[c] = cellStart[c - 1];
+            cellStart[0] = 0;
+        }
+
+        for (std::size_t c = 0; c < cells; ++c) {
+            if (cellStart[c + 1] > cellStart[c]) occupiedTmp.push_back(static_cast<std::uint32_t>(c));
+        }
+        if (occupiedTmp != occupied || occupiedCell != cell) {
+            occupied.swap(occupiedTmp);
+            occupiedCell = cell;
+            ++version;
+        }
+    }
+
+    void ensureBuilt() const {
+        if (dirty) build();
+    }
+
+    // cambia la entidad sin rearmar si sigue en la misma celda; false si hay
+    // que rearmar
+    bool patch(Id id, const sf::Vector2f& pos, float radius) {
+        if (dirty || id >= slotOf.size() || !entries[id].present) return false;
+        const std::uint32_t slot = slotOf[id];
+        if (cellX(pos.x) != cellX(xs[slot]) || cellY(pos.y) != cellY(ys[slot])) return false;
+        xs[slot] = pos.x;
+        ys[slot] = pos.y;
+        radii[slot] = radius;
+        maxRadius = std::max(maxRadius, radius);
+        return true;
+    }
+
+    // intersección exacta círculo / rectángulo
+    static bool overlaps(const sf::FloatRect& range, const sf::Vector2f& c, float r) {
+        if (r <= 0.f) return range.contains(c);
+        const float nx = std::clamp(c.x, range.position.x, range.position.x + range.size.x);
+        const float ny = std::clamp(c.y, range.position.y, range.position.y + range.size.y);
+        const float dx = c.x - nx;
+        const float dy = c.y - ny;
+        return dx * dx + dy * dy < r * r;
+    }
+
+    // el callback puede devolver void (seguir siempre) o bool (false corta)
+    template <typename F>
+    static bool emit(F& callback, Id id) {
+        if constexpr (std::is_void_v<std::invoke_result_t<F&, Id>>) {
+            callback(id);
+            return true;
+        } else {
+            return static_cast<bool>(callback(id));
+        }
+    }
+
+    // recorre las entidades de las celdas que tocan [x0, x1] x [y0, y1]; cada
+    // fila de celdas es un tramo contiguo del arreglo ordenado
+    template <typename F>
+    bool forEachInBox(float x0, float y0, float x1, float y1, F&& callback) const {
+        const int cx0 = cellX(x0);
+        const int cx1 = cellX(x1);
+        const int cy0 = cellY(y0);
+        const int cy1 = cellY(y1);
+        for (int cy = cy0; cy <= cy1; ++cy) {
+            const std::size_t row = static_cast<std::size_t>(cy) * cols;
+            const std::uint32_t end = cellStart[row + cx1 + 1];
+            for (std::uint32_t i = cellStart[row + cx0]; i < end; ++i) {
+                if (!callback(i)) return false;
+            }
+        }
+        return true;
+    }
+
+    // pares de items[first, last) con los que están después de ellos en el
+    // arreglo ordenado: cada par sale una sola vez
+    template <typename F>
+    void pairsFrom(std::size_t first, std::size_t last, float scale, F& callback) const {
+        for (std::size_t i = first; i < last; ++i) {
+            if (xs[i] == GONE) continue;
+            // unos ulps de más: el kernel hace la prueba exacta
+            const float reach = (radii[i] + maxRadius) * 1.0001f;
+            const int cx0 = cellX(xs[i] - reach);
+            const int cx1 = cellX(xs[i] + reach);
+            const int cy0 = cellY(ys[i] - reach);
+            const int cy1 = cellY(ys[i] + reach);
+            for (int cy = cy0; cy <= cy1; ++cy) {
+                const std::size_t row = static_cast<std::size_t>(cy) * cols;
+                const std::size_t begin = std::max<std::size_t>(cellStart[row + cx0], i + 1);
+                const std::size_t end = cellStart[row + cx1 + 1];
+                if (begin >= end) continue;
+                narrow::forEachOverlap(xs[i], ys[i], radii[i],
+                                       xs.data() + begin, ys.data() + begin, radii.data() + begin,
+                                       end - begin, scale,
+                                       [&](std::size_t k) { callback(items[i], items[begin + k]); });
+            }
+        }
+    }
+
+public:
+    // cellSize <= 0: tamaño automático según radio y densidad
+    explicit UniformGrid(const sf::FloatRect& bounds, float cellSize = 0.f)
+        : worldBounds(bounds), cellHint(cellSize) {}
+
+    float cellSize() const {
+        ensureBuilt();
+        return cell;
+    }
+
+    void reset() {
+        entries.clear();
+        dirty = true;
+    }
+
+    // la construcción se difiere hasta la primera consulta
+    void insert(Id id, const sf::Vector2f& pos, float radius) {
+        if (id >= entries.size()) entries.resize(id + 1, {{0.f, 0.f}, 0.f, false});
+        entries[id] = {pos, radius, true};
+        dirty = true;
+    }
+
+    void insert(Id id, const EntityStore& store) {
+        insert(id, store.position(id), store.radius[id]);
+    }
+
+    // reconstruye con todas las entidades del store (Id = índice)
+    void build(const EntityStore& store) {
+        entries.resize(store.size());
+        for (std::size_t i = 0; i < store.size(); ++i)
+            entries[i] = {store.position(i), store.radius[i], true};
+        build();
+    }
+
+    // misma interfaz que QuadTree::build(store, pool); el orden por celda se
+    // arma en serie
+    void build(const EntityStore& store, ThreadPool&) {
+        build(store);
+    }
+
+    void update(Id id, const sf::Vector2f& pos, float radius) {
+        if (patch(id, pos, radius))
+            entries[id] = {pos, radius, true};
+        else
+            insert(id, pos, radius);
+    }
+
+    void update(Id id, const EntityStore& store) {
+        update(id, store.position(id), store.radius[id]);
+    }
+
+    bool remove(Id id) {
+        if (!contains(id)) return false;
+        if (!dirty) {
+            xs[slotOf[id]] = GONE;
+            ys[slotOf[id]] = GONE;
+        }
+        entries[id].present = false;
+        return true;
+    }
+
+    // arma ya lo que update()/remove() dejaron pendiente, para que su costo
+    // se mida donde se causó y no en la próxima consulta
+    void flush() const {
+        ensureBuilt();
+    }
+
+    bool contains(Id id) const {
+        return id < entries.size() && entries[id].present;
+    }
+
+    // llama a callback(id) por cada entidad que toca el rectángulo; si
+    // callback devuelve bool, false detiene el recorrido
+    template <typename F>
+    bool visit(const sf::FloatRect& range, F&& callback) const {
+        ensureBuilt();
+        if (items.empty()) return true;
+        const float pad = maxRadius * 1.0001f;
+        return forEachInBox(range.position.x - pad, range.position.y - pad,
+                            range.position.x + range.size.x + pad,
+                            range.position.y + range.size.y + pad,
+                            [&](std::uint32_t i) {
+                                return !overlaps(range, {xs[i], ys[i]}, radii[i]) ||
+                                       emit(callback, items[i]);
+                            });
+    }
+
+    // igual que visit() pero contra el círculo (center, radius)
+    template <typename F>
+    bool visitCircle(const sf::Vector2f& center, float radius, F&& callback) const {
+        ensureBuilt();
+        if (items.empty()) return true;
+        const float reach = (radius + maxRadius) * 1.0001f;
+        return forEachInBox(center.x - reach, center.y - reach, center.x + reach, center.y + reach,
+                            [&](std::uint32_t i) {
+                                const float dx = xs[i] - center.x;
+                                const float dy = ys[i] - center.y;
+                                const float lim = radius + radii[i];
+                                return dx * dx + dy * dy >= lim * lim || emit(callback, items[i]);
+                            });
+    }
+
+    void queryRange(const sf::FloatRect& range, std::vector<Id>& found) const {
+        visit(range, [&found](Id id) { found.push_back(id); });
+    }
+
+    void queryCircle(const sf::Vector2f& center, float radius, std::vector<Id>& found) const {
+        visitCircle(center, radius, [&found](Id id) { found.push_back(id); });
+    }
+
+    // solo los pares cuyos círculos están a menos de scale * (ra + rb), con scale <= 1
+    template <typename F>
+    void forEachCollidingPair(float scale, F&& callback) const {
+        ensureBuilt();
+        pairsFrom(0, items.size(), scale, callback);
+    }
+
+    // los mismos pares repartidos por tramos del arreglo entre los hilos del
+    // pool y ordenados por (menor, mayor): el resultado no depende de los hilos
+    void collectCollidingPairs(float scale, ThreadPool& pool, std::vector<IdPair>& out) const {
+        ensureBuilt();
+        out.clear();
+        const std::size_t n = items.size();
+        if (n == 0) return;
+
+        const unsigned threads = pool.size();
+        workerPairs.resize(threads);
+        for (auto& buffer : workerPairs) buffer.clear();
+
+        const std::size_t tasks = threads > 1 ? 4u * threads : 1u;
+        const std::size_t chunk = (n + tasks - 1) / tasks;
+        pool.parallelFor(tasks, [&](std::size_t t, unsigned w) {
+            std::vector<IdPair>& buffer = workerPairs[w];
+            auto emitPair = [&](Id a, Id b) {
+                buffer.emplace_back(a < b ? a : b, a < b ? b : a);
+            };
+            const std::size_t first = std::min(n, t * chunk);
+            pairsFrom(first, std::min(n, first + chunk), scale, emitPair);
+        });
+
+        for (const auto& buffer : workerPairs)
+            out.insert(out.end(), buffer.begin(), buffer.end());
+        std::sort(out.begin(), out.end());
+    }
+
+    // cambia solo cuando cambia el conjunto de celdas ocupadas
+    std::uint64_t structureVersion() const {
+        ensureBuilt();
+        return version;
+    }
+
+    // las celdas ocupadas; igual que QuadTree::buildGrid
+    void buildGrid(GridOverlay& out) const {
+        ensureBuilt();
+        if (out.upToDate(version)) return;
+        out.clear();
+        for (std::uint32_t c : occupied) {
+            const float x = worldBounds.position.x + static_cast<float>(c % cols) * cell;
+            const float y = worldBounds.position.y + static_cast<float>(c / cols) * cell;
+            out.addRect(sf::FloatRect({x, y}, {cell, cell}));
+        }
+        out.finish(version);
+    }
+
+    void draw(sf::RenderWindow& window) const {
+        buildGrid(grid);
+        grid.draw(window);
+    }
+};
@@ -0,0 +1,27 @@
+#pragma once
+#include <cmath>
+#include <SFML/System/Vector2.hpp>
+
+// ------------------ utilidades matemáticas ------------------
+
+inline float length(const sf::Vector2f& v) {
+    return std::sqrt(v.x * v.x + v.y * v.y);
+}
+
+inline sf::Vector2f operator-(const sf::Vector2f& a, const sf::Vector2f& b) {
+    return {a.x - b.x, a.y - b.y};
+}
+
+inline sf::Vector2f operator+(const sf::Vector2f& a, const sf::Vector2f& b) {
+    return {a.x + b.x, a.y + b.y};
+}
+
+inline sf::Vector2f operator*(const sf::Vector2f& a, float s) {
+    return {a.x * s, a.y * s};
+}
+
+inline sf::Vector2f normalize(const sf::Vector2f& v) {
+    float len = length(v);
+    if (len == 0.f) return {0.f, 0.f};
+    return {v.x / len, v.y / len};
+}
@@ -0,0 +1,447 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <type_traits>
+#include "Simulation.h"
+#include "ThreadPool.h"
+#include "Replay.h"
+
+// Corre la Simulation sin ventana y muestra ns/frame por fase.
+//
+//   quadtree_bench [--mode debug|arcade] [--n 80,1000,100000] [--frames 300]
+//                  [--warmup 120] [--dt 0.016667] [--seed 1] [--threads 1,2,4]
+//                  [--fixed-world] [--auto-tune] [--broad-phase quadtree,grid,sap]
+//                  [--view] [--record archivo]
+//   quadtree_bench --replay archivo [--warmup 120] [--threads 1,2,4] [--auto-tune]
+//                  [--broad-phase ...] [--view]
+//
+// Por defecto el mundo crece con n para mantener la densidad del juego
+// (80 entidades en 800x600); --fixed-world lo deja en 800x600. Con
+// --auto-tune el árbol Arcade ajusta capacity y profundidad durante la
+// corrida; la columna "cap/prof" muestra donde terminó.
+//
+// --broad-phase corre cada n con cada fase amplia de la lista (o "all"), en
+// filas seguidas para compararlas; la partida es la misma con todas, asi que
+// la columna "final" debe coincidir.
+//
+// Compilado con QUADTREE_STATS (por defecto en debug), cada fila del QuadTree
+// lleva debajo sus contadores: nodos y entidades que mira cada consulta, y
+// cuántos candidatos prueba la búsqueda de pares por cada par que encuentra.
+//
+// Las filas del QuadTree llevan también los bytes de sus nodos al final y las
+// reservas de heap del árbol en cada fase, contadas después de los primeros
+// --warmup frames. En Arcade el árbol se reconstruye cada frame sobre el pool
+// y en régimen estable no reserva: si alguna fase lo hace el bench lo marca y
+// sale con código 3. En Debug el árbol se actualiza en el lugar y el pool de
+// cubetas de desborde todavía puede crecer la primera vez que un nodo junta
+// más círculos sobre sus divisiones que nunca, y con --auto-tune cada cambio de capacity o
+// profundidad arma otro árbol; esas reservas se muestran pero no fallan.
+//
+// Las filas de Arcade con el QuadTree muestran además cuánto de la columna
+// build se va en cada etapa de build(store, pool): partir los niveles de
+// arriba y pedir los nodos al pool corren en serie, describir y llenar los
+// subárboles en paralelo. Con varios valores en --threads todo se corre una
+// vez por cantidad de hilos y al final una tabla compara esas etapas.
+//
+// --view pide cada tick las entidades de una ventana de 800x600 en el centro
+// del mundo, como la cámara del juego; la columna "vista" mide esa consulta.
+//
+// --record guarda la corrida (con un solo n y un solo --threads) y --replay
+// repite una grabación, del bench o del juego (quadtree_game_menu --record),
+// con la misma tabla.
+// La repetición compara el estado final con el de la grabación y sale con
+// código 2 si difiere, asi una partida problemática se puede medir y
+// verificar en cada build.
+
+namespace {
+
+struct Options {
+    Simulation::Mode mode = Simulation::Mode::Arcade;
+    std::vector<int> counts{80, 1000, 10000, 100000, 1000000};
+    int frames = 300;
+    int warmup = 120;
+    float dt = 1.f / 60.f;
+    unsigned seed = 1;
+    std::vector<int> threads{1};
+    bool fixedWorld = false;
+    bool autoTune = false;
+    bool view = false;
+    std::vector<BroadPhaseKind> phases{BroadPhaseKind::QuadTree};
+    const char* record = nullptr;
+    const char* replay = nullptr;
+};
+
+std::vector<int> parseCounts(const char* text) {
+    std::vector<int> counts;
+    std::string item;
+    for (const char* c = text;; ++c) {
+        if (*c == ',' || *c == '\0') {
+            if (!item.empty()) counts.push_back(std::atoi(item.c_str()));
+            item.clear();
+            if (*c == '\0') break;
+        } else {
+            item += *c;
+        }
+    }
+    return counts;
+}
+
+// "quadtree,grid,sap" o "all"; vacío si algún nombre no existe
+std::vector<BroadPhaseKind> parsePhases(const char* text) {
+    std::vector<BroadPhaseKind> phases;
+    if (std::strcmp(text, "all") == 0) {
+        for (int k = 0; k < BROAD_PHASES; ++k) phases.push_back(static_cast<BroadPhaseKind>(k));
+        return phases;
+    }
+    std::string item;
+    for (const char* c = text;; ++c) {
+        if (*c == ',' || *c == '\0') {
+            BroadPhaseKind kind;
+            if (!parseBroadPhase(item.c_str(), kind)) return {};
+            phases.push_back(kind);
+            item.clear();
+            if (*c == '\0') break;
+        } else {
+            item += *c;
+        }
+    }
+    return phases;
+}
+
+bool parse(int argc, char** argv, Options& opt) {
+    for (int a = 1; a < argc; ++a) {
+        const bool hasValue = a + 1 < argc;
+        if (std::strcmp(argv[a], "--fixed-world") == 0) {
+            opt.fixedWorld = true;
+        } else if (std::strcmp(argv[a], "--auto-tune") == 0) {
+            opt.autoTune = true;
+        } else if (std::strcmp(argv[a], "--view") == 0) {
+            opt.view = true;
+        } else if (std::strcmp(argv[a], "--broad-phase") == 0 && hasValue) {
+            opt.phases = parsePhases(argv[++a]);
+        } else if (std::strcmp(argv[a], "--record") == 0 && hasValue) {
+            opt.record = argv[++a];
+        } else if (std::strcmp(argv[a], "--replay") == 0 && hasValue) {
+            opt.replay = argv[++a];
+        } else if (std::strcmp(argv[a], "--mode") == 0 && hasValue) {
+            const char* m = argv[++a];
+            if (std::strcmp(m, "debug") == 0)
+                opt.mode = Simulation::Mode::QuadDebug;
+            else if (std::strcmp(m, "arcade") == 0)
+                opt.mode = Simulation::Mode::Arcade;
+            else
+                return false;
+        } else if (std::strcmp(argv[a], "--n") == 0 && hasValue) {
+            opt.counts = parseCounts(argv[++a]);
+        } else if (std::strcmp(argv[a], "--frames") == 0 && hasValue) {
+            opt.frames = std::atoi(argv[++a]);
+        } else if (std::strcmp(argv[a], "--warmup") == 0 && hasValue) {
+            opt.warmup = std::atoi(argv[++a]);
+        } else if (std::strcmp(argv[a], "--dt") == 0 && hasValue) {
+            opt.dt = static_cast<float>(std::atof(argv[++a]));
+        } else if (std::strcmp(argv[a], "--seed") == 0 && hasValue) {
+            opt.seed = static_cast<unsigned>(std::strtoul(argv[++a], nullptr, 10));
+        } else if (std::strcmp(argv[a], "--threads") == 0 && hasValue) {
+            opt.threads = parseCounts(argv[++a]);
+        } else {
+            return false;
+        }
+    }
+    if (opt.record && (opt.replay || opt.counts.size() != 1 || opt.threads.size() != 1)) return false;
+    for (int t : opt.threads)
+        if (t <= 0) return false;
+    return !opt.counts.empty() && !opt.phases.empty() && !opt.threads.empty() && opt.frames > 0 &&
+           opt.warmup >= 0;
+}
+
+void accumulate(Simulation::PhaseTimes& sum, const Simulation::PhaseTimes& t) {
+    sum.move += t.move;
+    sum.spawn += t.spawn;
+    sum.build += t.build;
+    sum.collide += t.collide;
+    sum.resolve += t.resolve;
+    sum.player += t.player;
+    sum.compact += t.compact;
+    sum.view += t.view;
+}
+
+void accumulate(Simulation::PhaseAllocations& sum, const Simulation::PhaseAllocations& a) {
+    sum.move += a.move;
+    sum.spawn += a.spawn;
+    sum.build += a.build;
+    sum.collide += a.collide;
+    sum.resolve += a.resolve;
+    sum.player += a.player;
+    sum.compact += a.compact;
+    sum.view += a.view;
+}
+
+void accumulate(QuadTree::BuildTimes& sum, const QuadTree::BuildTimes& t) {
+    sum.split += t.split;
+    sum.layout += t.layout;
+    sum.nodes += t.nodes;
+    sum.fill += t.fill;
+}
+
+// ventana del tamaño del juego en el centro del mundo
+void setView(Simulation& sim) {
+    const sf::Vector2f screen(800.f, 600.f);
+    sim.setView(sf::FloatRect(sim.worldSize() / 2.f - screen / 2.f, screen));
+}
+
+void printColumns() {
+    std::printf("%10s %-9s %10s %10s %10s %10s %10s %10s %10s %10s %10s %12s %9s %10s\n",
+                "n", "fase", "final", "move", "spawn", "build", "collide", "resolve",
+                "player", "compact", "vista", "total", "cap/prof", "mundo");
+}
+
+void printRow(int n, const Simulation& sim, const Simulation::PhaseTimes& sum, double frames) {
+    const sf::Vector2f world = sim.worldSize();
+    // capacity y profundidad solo existen en el QuadTree
+    char limits[16] = "-";
+    if (sim.broadPhaseKind() == BroadPhaseKind::QuadTree)
+        std::snprintf(limits, sizeof(limits), "%d/%d", sim.arcadeTree().capacityLimit(),
+                      sim.arcadeTree().depthLimit());
+    std::printf("%10d %-9s %10zu %10.0f %10.0f %10.0f %10.0f %10.0f %10.0f %10.0f %10.0f %12.0f %9s %4.0fx%-5.0f\n",
+                n, broadPhaseName(sim.broadPhaseKind()), sim.entities().size(),
+                sum.move / frames, sum.spawn / frames, sum.build / frames,
+                sum.collide / frames, sum.resolve / frames, sum.player / frames,
+                sum.compact / frames, sum.view / frames, sum.total() / frames, limits,
+                world.x, world.y);
+}
+
+// el QuadTree del modo, o nullptr con otra fase amplia o con el árbol lineal
+const QuadTree* modeTree(const Simulation& sim) {
+    if (sim.broadPhaseKind() != BroadPhaseKind::QuadTree) return nullptr;
+    if (sim.mode() == Simulation::Mode::QuadDebug) return &sim.debugTree();
+    if constexpr (std::is_same_v<ArcadeTree, QuadTree>) return &sim.arcadeTree();
+    else return nullptr;
+}
+
+// contadores del árbol del modo; cada fila usa una Simulation nueva, asi que
+// empiezan en cero
+void printCounters(const Simulation& sim) {
+#if QUADTREE_STATS
+    const QuadTree* tree = modeTree(sim);
+    if (!tree) return;
+    const QuadTree::QueryCounters& c = tree->queryCounters();
+    const double queries = c.queries > 0 ? static_cast<double>(c.queries) : 1.0;
+    const double searches = c.pairSearches > 0 ? static_cast<double>(c.pairSearches) : 1.0;
+    const double found = c.pairsFound > 0 ? static_cast<double>(c.pairsFound) : 1.0;
+    std::printf("%10s consultas %llu: %.1f nodos, %.1f probadas, %.1f devueltas c/u | "
+                "pares: %.0f candidatos, %.0f en colisión por frame (%.1f por par)\n",
+                "", static_cast<unsigned long long>(c.queries), c.nodesVisited / queries,
+                c.entitiesTested / queries, c.entitiesReturned / queries,
+                c.pairsTested / searches, c.pairsFound / searches, c.pairsTested / found);
+#else
+    (void)sim;
+#endif
+}
+
+// el árbol que se reconstruye cada frame con build(store, pool), o nullptr
+const QuadTree* rebuiltTree(const Simulation& sim) {
+    return sim.mode() == Simulation::Mode::Arcade ? modeTree(sim) : nullptr;
+}
+
+// una fila del barrido de hilos
+struct BuildSample {
+    int n;
+    unsigned threads;
+    double build;
+    QuadTree::BuildTimes stages; // sumadas en todos los frames
+    double frames;
+};
+
+// etapas de build(store, pool) por frame; las guarda para el barrido
+void printStages(int n, const Simulation& sim, unsigned threads, double build,
+                 const QuadTree::BuildTimes& stages, double frames,
+                 std::vector<BuildSample>& samples) {
+    if (!rebuiltTree(sim)) return;
+    std::printf("%10s construcción: partir %.0f, describir %.0f, nodos %.0f, llenar %.0f ns/frame\n",
+                "", stages.split / frames, stages.layout / frames, stages.nodes / frames,
+                stages.fill / frames);
+    samples.push_back({n, threads, build, stages, frames});
+}
+
+// build y sus etapas contra la cantidad de hilos; "serie" es partir + nodos,
+// la parte que no se reparte
+void printSweep(std::vector<BuildSample> samples) {
+    std::stable_sort(samples.begin(), samples.end(),
+                     [](const BuildSample& a, const BuildSample& b) { return a.n < b.n; });
+    std::printf("\nbuild del QuadTree por hilos (ns/frame)\n");
+    std::printf("%10s %6s %10s %10s %10s %10s %10s %10s %8s\n", "n", "hilos", "build", "partir",
+                "describir", "nodos", "llenar", "serie", "acelera");
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        const BuildSample& s = samples[i];
+        std::size_t base = i;
+        while (base > 0 && samples[base - 1].n == s.n) --base;
+        const double f = s.frames;
+        std::printf("%10d %6u %10.0f %10.0f %10.0f %10.0f %10.0f %10.0f %7.2fx\n", s.n, s.threads,
+                    s.build / f, s.stages.split / f, s.stages.layout / f, s.stages.nodes / f,
+                    s.stages.fill / f, (s.stages.split + s.stages.nodes) / f,
+                    s.build > 0.0 ? (samples[base].build / samples[base].frames) / (s.build / f) : 0.0);
+    }
+}
+
+// memoria del árbol y sus reservas por fase pasado el calentamiento; false
+// si el árbol de Arcade reservó con capacity y profundidad fijas
+bool printAllocations(const Simulation& sim, int warmup, const Simulation::PhaseAllocations& warm,
+                      const Simulation::PhaseAllocations& after) {
+    if (!modeTree(sim)) return true;
+    const bool arcade = sim.mode() == Simulation::Mode::Arcade;
+    const bool checked = arcade && !sim.autoTuning();
+    const char* mark = "";
+    if (after.total() > 0) {
+        if (checked) mark = "  <- RESERVA EN RÉGIMEN ESTABLE";
+        else mark = arcade ? "  (auto-tune cambió el árbol)" : "  (máximos nuevos)";
+    }
+    std::printf("%10s nodos %zu KiB | reservas: %zu en %d frames de calentamiento, después "
+                "move %zu spawn %zu build %zu collide %zu resolve %zu player %zu compact %zu "
+                "vista %zu%s\n",
+                "", sim.treeNodeBytes() / 1024, warm.total(), warmup, after.move, after.spawn,
+                after.build, after.collide, after.resolve, after.player, after.compact,
+                after.view, mark);
+    return !checked || after.total() == 0;
+}
+
+// repite la grabación tal cual; 2 si el estado final no coincide, 3 si el
+// árbol reservó memoria pasado el calentamiento
+int runReplay(const Options& opt, ThreadPool& pool, std::vector<BuildSample>& samples) {
+    replay::Player rec;
+    if (!rec.open(opt.replay)) {
+        std::fprintf(stderr, "%s no es una grabación válida\n", opt.replay);
+        return 1;
+    }
+    const replay::Header& h = rec.header();
+    std::printf("replay=%s modo=%s frames=%zu seed=%u hilos=%u kernel=%s\n", opt.replay,
+                h.mode == Simulation::Mode::Arcade ? "arcade" : "debug", rec.frames(), h.seed,
+                pool.size(), narrow::kernelName());
+    printColumns();
+
+    bool same = true;
+    bool steady = true;
+    for (BroadPhaseKind kind : opt.phases) {
+        Simulation sim(h.width, h.height, pool);
+        sim.setAutoTune(opt.autoTune);
+        sim.setBroadPhase(kind);
+        if (opt.view) setView(sim);
+        rec.start(sim);
+
+        Simulation::PhaseTimes sum;
+        Simulation::PhaseAllocations warm, after;
+        QuadTree::BuildTimes stages;
+        for (std::size_t f = 0; f < rec.frames(); ++f) {
+            const replay::Frame fr = rec.frame(f);
+            sim.step(fr.dt, fr.dir);
+            accumulate(sum, sim.times());
+            accumulate(f < static_cast<std::size_t>(opt.warmup) ? warm : after, sim.allocations());
+            if (const QuadTree* tree = rebuiltTree(sim)) accumulate(stages, tree->buildTimes());
+        }
+        const double frames = rec.frames() > 0 ? static_cast<double>(rec.frames()) : 1.0;
+        printRow(h.count, sim, sum, frames);
+        printCounters(sim);
+        printStages(h.count, sim, pool.size(), static_cast<double>(sum.build), stages, frames, samples);
+        steady = printAllocations(sim, opt.warmup, warm, after) && steady;
+        same = same && rec.matches(sim);
+    }
+
+    if (!rec.hasChecksum()) {
+        std::printf("grabación sin cerrar: no hay estado final para comparar\n");
+        return steady ? 0 : 3;
+    }
+    std::printf("estado final: %s\n", same ? "igual a la grabación" : "DIFERENTE de la grabación");
+    if (!same) return 2;
+    return steady ? 0 : 3;
+}
+
+// una pasada por todos los n y fases amplias; 3 si el árbol reservó memoria
+// pasado el calentamiento
+int runCounts(const Options& opt, ThreadPool& pool, std::vector<BuildSample>& samples) {
+    const bool arcade = opt.mode == Simulation::Mode::Arcade;
+
+    std::printf("modo=%s frames=%d dt=%g seed=%u hilos=%u kernel=%s\n",
+                arcade ? "arcade" : "debug", opt.frames, opt.dt, opt.seed,
+                pool.size(), narrow::kernelName());
+    printColumns();
+
+    bool steady = true;
+    for (int n : opt.counts) {
+        if (n <= 0) continue;
+        float width = 800.f;
+        float height = 600.f;
+        if (!opt.fixedWorld) {
+            const float grow = std::sqrt(n / 80.f);
+            if (grow > 1.f) {
+                width = std::floor(width * grow);
+                height = std::floor(height * grow);
+            }
+        }
+
+        for (BroadPhaseKind kind : opt.phases) {
+            Simulation sim(width, height, pool);
+            sim.setInvulnerable(true);
+            sim.setAutoTune(opt.autoTune);
+            sim.setBroadPhase(kind);
+            if (opt.view) setView(sim);
+            sim.reset(opt.mode, opt.seed, n, n);
+
+            // la partida es la misma con todas las fases: se graba la primera
+            replay::Recorder recorder;
+            if (opt.record && kind == opt.phases.front() &&
+                !recorder.begin(opt.record, sim, opt.seed, n, n)) {
+                std::fprintf(stderr, "no se pudo grabar en %s\n", opt.record);
+                return 1;
+            }
+
+            Simulation::PhaseTimes sum;
+            Simulation::PhaseAllocations warm, after;
+            QuadTree::BuildTimes stages;
+            for (int f = 0; f < opt.frames; ++f) {
+                sim.step(opt.dt, recorder.frame(opt.dt, {0.f, 0.f}));
+                accumulate(sum, sim.times());
+                accumulate(f < opt.warmup ? warm : after, sim.allocations());
+                if (const QuadTree* tree = rebuiltTree(sim)) accumulate(stages, tree->buildTimes());
+            }
+            recorder.finish(sim);
+
+            printRow(n, sim, sum, opt.frames);
+            printCounters(sim);
+            printStages(n, sim, pool.size(), static_cast<double>(sum.build), stages, opt.frames,
+                        samples);
+            steady = printAllocations(sim, opt.warmup, warm, after) && steady;
+        }
+    }
+    return steady ? 0 : 3;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse(argc, argv, opt)) {
+        std::fprintf(stderr,
+                     "uso: %s [--mode debug|arcade] [--n 80,1000,...] [--frames F] [--warmup W]\n"
+                     "       [--dt DT] [--seed S] [--threads 1,2,...] [--fixed-world] [--auto-tune]\n"
+                     "       [--broad-phase quadtree,grid,sap|all] [--view] [--record archivo (con un solo n y T)]\n"
+                     "   o:  %s --replay archivo [--warmup W] [--threads 1,2,...] [--auto-tune] [--broad-phase ...] [--view]\n",
+                     argv[0], argv[0]);
+        return 1;
+    }
+
+    // una corrida completa por cantidad de hilos; la diferencia de estado
+    // (2) pesa más que las reservas (3)
+    int status = 0;
+    std::vector<BuildSample> samples;
+    for (int t : opt.threads) {
+        ThreadPool pool(static_cast<unsigned>(t));
+        const int code = opt.replay ? runReplay(opt, pool, samples) : runCounts(opt, pool, samples);
+        if (code == 1) return 1;
+        if (code == 2 || status == 0) status = code;
+    }
+    if (opt.threads.size() > 1 && !samples.empty()) printSweep(samples);
+    return status;
+}
@@ -1,36 +1,18 @@
 #include <SFML/Graphics.hpp>
 #include <vector>
 #include <cmath>
+#include <algorithm>
 #include <cstdlib>
 #include <ctime>
 #include <optional>
 #include <string>
-#include "Entity.h"
-#include "QuadTree.h"
-
-// ------------------ utilidades matemáticas ------------------
-
-float length(const sf::Vector2f& v) {
-    return std::sqrt(v.x * v.x + v.y * v.y);
-}
-
-sf::Vector2f operator-(const sf::Vector2f& a, const sf::Vector2f& b) {
-    return {a.x - b.x, a.y - b.y};
-}
-
-sf::Vector2f operator+(const sf::Vector2f& a, const sf::Vector2f& b) {
-    return {a.x + b.x, a.y + b.y};
-}
-
-sf::Vector2f operator*(const sf::Vector2f& a, float s) {
-    return {a.x * s, a.y * s};
-}
-
-sf::Vector2f normalize(const sf::Vector2f& v) {
-    float len = length(v);
-    if (len == 0.f) return {0.f, 0.f};
-    return {v.x / len, v.y / len};
-}
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include "Simulation.h"
+#include "SimulationThread.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
 
 // ------------------ pantallas ------------------
 
@@ -54,87 +36,219 @@ std::string formatTime(float seconds) {
 
 // ------------------ dibujo ------------------
 
-void drawAlien(sf::RenderWindow& window,
-               const sf::Vector2f& center,
-               float baseSize,
-               sf::Color color) {
-    const int W = 11;
-    const int H = 8;
-    const int pattern[H][W] = {
-        {0,0,1,0,0,0,0,0,1,0,0},
-        {0,0,0,1,0,0,0,1,0,0,0},
-        {0,0,1,1,1,1,1,1,1,0,0},
-        {0,1,1,0,1,1,1,0,1,1,0},
-        {1,1,1,1,1,1,1,1,1,1,1},
-        {1,0,1,1,1,1,1,1,1,0,1},
-        {1,0,1,0,0,0,0,0,1,0,1},
-        {0,0,0,1,1,0,1,1,0,0,0},
-    };
-    /*const int pattern[H][W] = {
-        {0,0,1,1,1,1,1,0,1,0,0},
-        {0,1,1,1,1,1,1,1,1,1,0},
-        {1,1,0,1,1,1,1,1,0,1,1},
-        {1,1,1,1,1,1,1,1,1,1,1},
-        {1,1,1,0,1,1,1,0,1,1,1},
-        {1,1,1,1,1,1,1,1,1,1,1},
-        {1,1,0,1,0,0,0,1,0,1,1},
-        {0,0,0,0,1,1,1,0,0,0,0},
-    };*/
-
-    float scale = baseSize / static_cast<float>(H);
-    sf::RectangleShape pixel;
-    pixel.setSize({scale, scale});
-    pixel.setFillColor(color);
-
-    float totalWidth  = W * scale;
-    float totalHeight = H * scale;
+const int ALIEN_W = 11;
+const int ALIEN_H = 8;
+const int ALIEN_PATTERN[ALIEN_H][ALIEN_W] = {
+    {0,0,1,0,0,0,0,0,1,0,0},
+    {0,0,0,1,0,0,0,1,0,0,0},
+    {0,0,1,1,1,1,1,1,1,0,0},
+    {0,1,1,0,1,1,1,0,1,1,0},
+    {1,1,1,1,1,1,1,1,1,1,1},
+    {1,0,1,1,1,1,1,1,1,0,1},
+    {1,0,1,0,0,0,0,0,1,0,1},
+    {0,0,0,1,1,0,1,1,0,0,0},
+};
+/*const int ALIEN_PATTERN[ALIEN_H][ALIEN_W] = {
+    {0,0,1,1,1,1,1,0,1,0,0},
+    {0,1,1,1,1,1,1,1,1,1,0},
+    {1,1,0,1,1,1,1,1,0,1,1},
+    {1,1,1,1,1,1,1,1,1,1,1},
+    {1,1,1,0,1,1,1,0,1,1,1},
+    {1,1,1,1,1,1,1,1,1,1,1},
+    {1,1,0,1,0,0,0,1,0,1,1},
+    {0,0,0,0,1,1,1,0,0,0,0},
+};*/
+
+// celdas encendidas del patrón (cada una son 2 triángulos)
+int alienCells() {
+    int cells = 0;
+    for (int y = 0; y < ALIEN_H; ++y)
+        for (int x = 0; x < ALIEN_W; ++x)
+            cells += ALIEN_PATTERN[y][x];
+    return cells;
+}
+
+// escribe el marciano en vertices[v, v + 6 * alienCells()) y devuelve el
+// siguiente vértice libre; todos los enemigos van en un solo draw call
+std::size_t writeAlien(sf::VertexArray& vertices,
+                       std::size_t v,
+                       const sf::Vector2f& center,
+                       float baseSize,
+                       sf::Color color) {
+    float scale = baseSize / static_cast<float>(ALIEN_H);
+
+    float totalWidth  = ALIEN_W * scale;
+    float totalHeight = ALIEN_H * scale;
     sf::Vector2f topLeft(center.x - totalWidth / 2.f,
                          center.y - totalHeight / 2.f);
 
-    for (int y = 0; y < H; ++y) {
-        for (int x = 0; x < W; ++x) {
-            if (pattern[y][x] == 0) continue;
-            pixel.setPosition(sf::Vector2f(
-                topLeft.x + x * scale,
-                topLeft.y + y * scale
-            ));
-            window.draw(pixel);
+    for (int y = 0; y < ALIEN_H; ++y) {
+        for (int x = 0; x < ALIEN_W; ++x) {
+            if (ALIEN_PATTERN[y][x] == 0) continue;
+            const float left   = topLeft.x + x * scale;
+            const float top    = topLeft.y + y * scale;
+            const float right  = left + scale;
+            const float bottom = top + scale;
+
+            const sf::Vector2f corners[6] = {
+                {left, top}, {right, top}, {left, bottom},
+                {left, bottom}, {right, top}, {right, bottom},
+            };
+            for (const sf::Vector2f& corner : corners) {
+                vertices[v].position = corner;
+                vertices[v].color = color;
+                ++v;
+            }
         }
     }
+    return v;
+}
+
+// ------------------ fase amplia ------------------
+
+// promedio móvil (ms por tick) de las fases que dependen de la fase amplia;
+// cada una guarda el suyo, asi al cambiar con [B] quedan lado a lado
+struct BroadPhaseTimes {
+    double build = 0.0;
+    double collide = 0.0;
+    double resolve = 0.0;
+    double player = 0.0;
+    double view = 0.0;
+    bool measured = false;
+
+    void add(const Simulation::PhaseTimes& sum, int ticks) {
+        if (ticks <= 0) return;
+        const double k = measured ? 0.05 : 1.0;
+        const double scale = 1e-6 / ticks;
+        build += (sum.build * scale - build) * k;
+        collide += (sum.collide * scale - collide) * k;
+        resolve += (sum.resolve * scale - resolve) * k;
+        player += (sum.player * scale - player) * k;
+        view += (sum.view * scale - view) * k;
+        measured = true;
+    }
+};
+
+void drawBroadPhaseTable(sf::RenderWindow& window, const sf::Font& font,
+                         const BroadPhaseTimes (&times)[BROAD_PHASES],
+                         BroadPhaseKind active, const sf::Vector2f& origin) {
+    std::string msg = "fase amplia  arbol  pares fusion jugad  vista\n";
+    char line[96];
+    for (int k = 0; k < BROAD_PHASES; ++k) {
+        const BroadPhaseTimes& t = times[k];
+        const auto kind = static_cast<BroadPhaseKind>(k);
+        const char mark = kind == active ? '>' : ' ';
+        if (t.measured)
+            std::snprintf(line, sizeof(line), "%c %-9s %6.3f %6.3f %6.3f %6.3f %6.3f\n", mark,
+                          broadPhaseName(kind), t.build, t.collide, t.resolve, t.player, t.view);
+        else
+            std::snprintf(line, sizeof(line), "%c %-9s      -      -      -      -      -\n", mark,
+                          broadPhaseName(kind));
+        msg += line;
+    }
+    msg += "ms por tick | [B] cambiar";
+
+    sf::Text t(font, msg, 12);
+    t.setPosition(origin);
+    t.setFillColor(sf::Color::White);
+    t.setOutlineColor(sf::Color::Black);
+    t.setOutlineThickness(1.f);
+    window.draw(t);
+}
+
+// ------------------ cámara ------------------
+
+// centro de la cámara sin mostrar nada fuera del mundo
+sf::Vector2f clampCamera(sf::Vector2f center, const sf::Vector2f& viewSize, const sf::Vector2f& world) {
+    const sf::Vector2f half = viewSize / 2.f;
+    center.x = std::min(std::max(center.x, half.x), world.x - half.x);
+    center.y = std::min(std::max(center.y, half.y), world.y - half.y);
+    return center;
 }
 
 // ------------------ main ------------------
 
-int main() {
+int main(int argc, char** argv) {
     std::srand(static_cast<unsigned>(std::time(nullptr)));
 
+    // --threads N: hilos para la detección de colisiones (1 = en serie)
+    // --record archivo: graba la última partida para quadtree_bench --replay
+    // --broad-phase quadtree|grid|sap: fase amplia inicial (se cambia con [B])
+    // --world-scale K: mundo K veces la ventana por lado, con K^2 veces las
+    // entidades; la cámara sigue al jugador (en el modo QuadTree, WASD)
+    unsigned threads = 1;
+    const char* recordPath = nullptr;
+    BroadPhaseKind broadPhase = BroadPhaseKind::QuadTree;
+    float worldScale = 1.f;
+    for (int a = 1; a + 1 < argc; ++a) {
+        if (std::strcmp(argv[a], "--threads") == 0) {
+            int n = std::atoi(argv[a + 1]);
+            if (n > 0) threads = static_cast<unsigned>(n);
+        } else if (std::strcmp(argv[a], "--record") == 0) {
+            recordPath = argv[a + 1];
+        } else if (std::strcmp(argv[a], "--broad-phase") == 0) {
+            if (!parseBroadPhase(argv[a + 1], broadPhase))
+                std::fprintf(stderr, "fase amplia desconocida: %s\n", argv[a + 1]);
+        } else if (std::strcmp(argv[a], "--world-scale") == 0) {
+            const float k = static_cast<float>(std::atof(argv[a + 1]));
+            if (k > 1.f) worldScale = k;
+        }
+    }
+    ThreadPool pool(threads);
+
     const unsigned WIDTH  = 800;
     const unsigned HEIGHT = 600;
-    const float RADIUS = 6.f;
+    const float RADIUS = Simulation::RADIUS;
 
     sf::RenderWindow window(sf::VideoMode({WIDTH, HEIGHT}), "QuadTree");
     window.setFramerateLimit(60);
 
-    sf::FloatRect world({0.f, 0.f}, {static_cast<float>(WIDTH), static_cast<float>(HEIGHT)});
-
     Screen current = Screen::Menu;
 
+    // ------------ mundo y cámara ------------
+    // el mundo puede ser más grande que la ventana; se dibuja con camera y
+    // el texto con la vista por defecto. La simulación solo copia lo que toca
+    // la cámara más VIEW_MARGIN: lo que entra durante un tick y el marciano,
+    // que se dibuja más ancho que su círculo
+    const sf::Vector2f screen(static_cast<float>(WIDTH), static_cast<float>(HEIGHT));
+    const sf::Vector2f world(std::floor(screen.x * worldScale), std::floor(screen.y * worldScale));
+    const float density = worldScale * worldScale;
+    const float VIEW_MARGIN = 64.f;
+    const float CAMERA_SPEED = 600.f; // px/s al mover la cámara del modo QuadTree
+    sf::View camera(world / 2.f, screen);
+    sf::Vector2f debugCamera = world / 2.f;
+    auto cullRect = [&](const sf::Vector2f& center) {
+        const sf::Vector2f margin(VIEW_MARGIN, VIEW_MARGIN);
+        return sf::FloatRect(center - screen / 2.f - margin, screen + 2.f * margin);
+    };
+    sf::Clock frameClock;
+
+    // la lógica de ambos modos vive en Simulation y corre a paso fijo en su
+    // propio hilo; aquí solo entrada y dibujo de los Snapshot que publica
+    const float TICK = 1.f / 60.f;
+    Simulation sim(world.x, world.y, pool);
+    SimulationThread simThread(sim, TICK);
+    if (recordPath) simThread.record(recordPath);
+    simThread.setBroadPhase(broadPhase);
+    BroadPhaseTimes broadPhaseTimes[BROAD_PHASES];
+
+    // [F3] muestra el perfilador por fases, [F4] guarda trace.json
+    Profiler profiler;
+
     // ------------ modo debug ------------
-    QuadTree quadDebug(world, 4);
-    std::vector<Entity> debugEntities;
-    bool debugInitialized = false;
+    sf::CircleShape debugShape(RADIUS); // forma compartida, solo para dibujar
+    debugShape.setOrigin({RADIUS, RADIUS});
     bool showGridDebug = false;
 
     // ------------ modo arcade ------------
-    QuadTree quadArcade(world, 4);
-    std::vector<Entity> arcadeEnemies;
-    Entity player;
-    bool arcadeInitialized = false;
-    bool arcadeGameOver = false;
     bool showGridArcade = false;
-    float arcadeSurvivalTime = 0.f;
-    float arcadeSpawnTimer = 0.f;
-    const int arcadeMaxEnemies = 80;
+    bool autoTune = false;
+    sf::CircleShape playerShape;
+    sf::VertexArray alienVertices(sf::PrimitiveType::Triangles);
+    const std::size_t alienVertexCount = 6 * static_cast<std::size_t>(alienCells());
+    const int debugCount = static_cast<int>(80 * density);
+    const int arcadeStartEnemies = static_cast<int>(45 * density);
+    const int arcadeMaxEnemies = static_cast<int>(80 * density);
 
     // ------------ fuente ------------
     sf::Font font;
@@ -157,143 +271,170 @@ int main() {
         bgSprite->setPosition(sf::Vector2f(0.f, 0.f));
     }
 
-    sf::Clock clock;
-
     while (window.isOpen()) {
-        // ----------- eventos -----------
-        while (std::optional<sf::Event> ev = window.pollEvent()) {
-            const sf::Event& event = *ev;
+        profiler.beginFrame();
+        const float frameDt = frameClock.restart().asSeconds();
 
-            if (event.is<sf::Event::Closed>()) {
-                window.close();
-            } else if (const auto* keyPressed = event.getIf<sf::Event::KeyPressed>()) {
-                auto key = keyPressed->code;
+        // ----------- eventos -----------
+        {
+            Profiler::Scope inputScope(profiler, Profiler::Phase::Input);
+            while (std::optional<sf::Event> ev = window.pollEvent()) {
+                const sf::Event& event = *ev;
 
-                if (key == sf::Keyboard::Key::Escape) {
+                if (event.is<sf::Event::Closed>()) {
                     window.close();
-                }
+                } else if (const auto* keyPressed = event.getIf<sf::Event::KeyPressed>()) {
+                    auto key = keyPressed->code;
 
-                if (current == Screen::Menu) {
-                    if (key == sf::Keyboard::Key::Num1) {
-                        current = Screen::QuadDebug;
-                        debugInitialized = false;
-                    } else if (key == sf::Keyboard::Key::Num2) {
-                        current = Screen::Arcade;
-                        arcadeInitialized = false;
-                        arcadeGameOver = false;
+                    if (key == sf::Keyboard::Key::Escape) {
+                        window.close();
                     }
-                } else {
-                    if (key == sf::Keyboard::Key::M) {
-                        current = Screen::Menu;
-                    }
-                    if (current == Screen::Arcade && key == sf::Keyboard::Key::R) {
-                        arcadeInitialized = false;
-                        arcadeGameOver = false;
+
+                    // perfilador: overlay y volcado del trace
+                    if (key == sf::Keyboard::Key::F3) {
+                        profiler.toggle();
+                    } else if (key == sf::Keyboard::Key::F4) {
+                        if (profiler.writeTrace("trace.json"))
+                            std::printf("trace guardado en trace.json\n");
                     }
-                    if (key == sf::Keyboard::Key::Space) {
-                        if (current == Screen::QuadDebug)
-                            showGridDebug = !showGridDebug;
-                        else if (current == Screen::Arcade)
-                            showGridArcade = !showGridArcade;
+
+                    if (current == Screen::Menu) {
+                        if (key == sf::Keyboard::Key::Num1) {
+                            current = Screen::QuadDebug;
+                            simThread.setShowGrid(showGridDebug);
+                            debugCamera = world / 2.f;
+                            simThread.start(Simulation::Mode::QuadDebug,
+                                            static_cast<unsigned>(std::rand()), debugCount);
+                        } else if (key == sf::Keyboard::Key::Num2) {
+                            current = Screen::Arcade;
+                            simThread.setShowGrid(showGridArcade);
+                            simThread.start(Simulation::Mode::Arcade,
+                                            static_cast<unsigned>(std::rand()), arcadeStartEnemies,
+                                            arcadeMaxEnemies);
+                        }
+                    } else {
+                        if (key == sf::Keyboard::Key::M) {
+                            current = Screen::Menu;
+                            simThread.pause();
+                        }
+                        if (current == Screen::Arcade && key == sf::Keyboard::Key::R) {
+                            simThread.start(Simulation::Mode::Arcade,
+                                            static_cast<unsigned>(std::rand()), arcadeStartEnemies,
+                                            arcadeMaxEnemies);
+                        }
+                        // [T] ajuste automático de capacity/profundidad del árbol
+                        if (current == Screen::Arcade && key == sf::Keyboard::Key::T) {
+                            autoTune = !autoTune;
+                            simThread.setAutoTune(autoTune);
+                        }
+                        // [B] siguiente fase amplia (QuadTree, cuadrícula, barrido)
+                        if (key == sf::Keyboard::Key::B) {
+                            broadPhase = nextBroadPhase(broadPhase);
+                            simThread.setBroadPhase(broadPhase);
+                        }
+                        if (key == sf::Keyboard::Key::Space) {
+                            if (current == Screen::QuadDebug) {
+                                showGridDebug = !showGridDebug;
+                                simThread.setShowGrid(showGridDebug);
+                            } else if (current == Screen::Arcade) {
+                                showGridArcade = !showGridArcade;
+                                simThread.setShowGrid(showGridArcade);
+                            }
+                        }
                     }
                 }
             }
         }
 
-        float dt = clock.restart().asSeconds();
+        // el Snapshot más nuevo y cuánto de su tick ya pasó; las fases de
+        // la simulación (en su hilo) se suman al frame del perfilador
+        const SimulationThread::Snapshot* snap = nullptr;
+        float alpha = 1.f;
+        if (current != Screen::Menu) {
+            snap = simThread.acquire();
+            if (snap) alpha = simThread.alpha(*snap);
+
+            int ticks = 0;
+            const Simulation::PhaseTimes t = simThread.takeTimes(&ticks);
+            if (snap) broadPhaseTimes[static_cast<int>(snap->broadPhase)].add(t, ticks);
+            profiler.add(Profiler::Phase::Move, t.move);
+            profiler.add(Profiler::Phase::Spawn, t.spawn);
+            profiler.add(Profiler::Phase::Build, t.build);
+            profiler.add(Profiler::Phase::Collide, t.collide);
+            profiler.add(Profiler::Phase::Resolve, t.resolve);
+            profiler.add(Profiler::Phase::Player, t.player);
+            profiler.add(Profiler::Phase::Compact, t.compact);
+            profiler.add(Profiler::Phase::View, t.view);
+        }
 
         // ======================================================
         //                       DEBUG
         // ======================================================
         if (current == Screen::QuadDebug) {
-            if (!debugInitialized) {
-                debugEntities.clear();
-                for (int i = 0; i < 80; ++i) {
-                    sf::Vector2f pos(
-                        static_cast<float>(std::rand() % WIDTH),
-                        static_cast<float>(std::rand() % HEIGHT)
-                    );
-                    sf::Vector2f vel(
-                        (std::rand() % 100 - 50) / 50.f,
-                        (std::rand() % 100 - 50) / 50.f
-                    );
-                    debugEntities.emplace_back(EntityKind::Enemy, pos, RADIUS, vel);
-                }
-                debugInitialized = true;
-            }
-
-            for (auto& e : debugEntities) e.colliding = false;
-
-            // mover
-            for (auto& e : debugEntities) {
-                sf::Vector2f pos = e.shape.getPosition();
-                pos += e.velocity * 100.f * dt;
-
-                if (pos.x - RADIUS < 0.f) {
-                    pos.x = RADIUS;
-                    e.velocity.x *= -1.f;
-                } else if (pos.x + RADIUS > WIDTH) {
-                    pos.x = WIDTH - RADIUS;
-                    e.velocity.x *= -1.f;
-                }
-
-                if (pos.y - RADIUS < 0.f) {
-                    pos.y = RADIUS;
-                    e.velocity.y *= -1.f;
-                } else if (pos.y + RADIUS > HEIGHT) {
-                    pos.y = HEIGHT - RADIUS;
-                    e.velocity.y *= -1.f;
-                }
-
-                e.shape.setPosition(pos);
-            }
-
-            // reconstruir QuadTree
-            quadDebug.reset();
-            for (auto& e : debugEntities) {
-                quadDebug.insert(&e);
-            }
-
-            // detectar colisiones usando QuadTree
-            for (auto& e : debugEntities) {
-                sf::Vector2f pos = e.shape.getPosition();
-                float querySize = RADIUS * 4.f;
-                sf::FloatRect range(
-                    {pos.x - querySize / 2.f, pos.y - querySize / 2.f},
-                    {querySize, querySize}
-                );
-
-                std::vector<Entity*> candidates;
-                quadDebug.queryRange(range, candidates);
-
-                for (auto* other : candidates) {
-                    if (&e == other) continue;
-                    sf::Vector2f diff = other->shape.getPosition() - pos;
-                    if (length(diff) < 2 * RADIUS) {
-                        e.colliding = true;
-                        other->colliding = true;
-                    }
-                }
+            // cámara libre con WASD o flechas (solo si el mundo no cabe en la ventana)
+            {
+                Profiler::Scope inputScope(profiler, Profiler::Phase::Input);
+                sf::Vector2f pan(0.f, 0.f);
+                if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::A) ||
+                    sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Left))
+                    pan.x -= 1.f;
+                if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::D) ||
+                    sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Right))
+                    pan.x += 1.f;
+                if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::W) ||
+                    sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Up))
+                    pan.y -= 1.f;
+                if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::S) ||
+                    sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Down))
+                    pan.y += 1.f;
+                debugCamera = clampCamera(debugCamera + normalize(pan) * CAMERA_SPEED * frameDt,
+                                          screen, world);
+                camera.setCenter(debugCamera);
+                simThread.setView(cullRect(debugCamera));
             }
 
             // dibujar
+            Profiler::Scope renderScope(profiler, Profiler::Phase::Render);
             window.clear();
             if (bgSprite) window.draw(*bgSprite);
 
-            if (showGridDebug) {
-                quadDebug.draw(window);
+            window.setView(camera);
+            if (snap && snap->hasGrid) {
+                snap->grid.draw(window);
             }
 
-            for (auto& e : debugEntities) {
-                e.shape.setFillColor(e.colliding ? sf::Color::Red : sf::Color::White);
-                window.draw(e.shape);
+            const std::size_t count = snap ? snap->size() : 0;
+            for (std::size_t i = 0; i < count; ++i) {
+                debugShape.setPosition(snap->position(i, alpha));
+                debugShape.setFillColor((snap->flags[i] & EntityStore::Colliding)
+                                            ? sf::Color::Red : sf::Color::White);
+                window.draw(debugShape);
             }
+            window.setView(window.getDefaultView());
 
             if (hasFont) {
                 std::string msg =
                     "QUADTREE\n"
-                    "[ESPACE] Quadtree\n"
-                    "[M] Menu | [ESC] Salir";
+                    "[ESPACE] Quadtree | [B] Fase amplia: ";
+                msg += broadPhaseName(broadPhase);
+                msg += "\n[M] Menu | [ESC] Salir";
+                if (worldScale > 1.f && snap) {
+                    char line[64];
+                    std::snprintf(line, sizeof(line), "\n[WASD] Camara | visibles %zu de %zu",
+                                  snap->size(), snap->total);
+                    msg += line;
+                }
+
+                // con la cuadrícula visible, la forma del árbol
+                if (snap && snap->hasGrid && snap->broadPhase == BroadPhaseKind::QuadTree) {
+                    const QuadTree::Stats& st = snap->stats;
+                    char line[96];
+                    std::snprintf(line, sizeof(line),
+                                  "\nnodos %zu | hojas %zu | prof. max %d | media %.1f | por hoja %.1f",
+                                  st.nodes, st.leaves, st.maxDepth, st.averageLeafDepth,
+                                  st.entitiesPerLeaf);
+                    msg += line;
+                }
                 sf::Text t(font, msg, 18);
                 auto bounds = t.getLocalBounds();
                 t.setOrigin(sf::Vector2f(bounds.size.x / 2.f, 0.f));
@@ -303,62 +444,16 @@ int main() {
                 t.setOutlineThickness(2.f);
                 window.draw(t);
             }
-
-            window.display();
         }
 
         // ======================================================
         //                       ARCADE
         // ======================================================
         else if (current == Screen::Arcade) {
-            const sf::Vector2f center(static_cast<float>(WIDTH) / 2.f,
-                                      static_cast<float>(HEIGHT) / 2.f);
-            const float safeRadius = 100.f;
-
-            if (!arcadeInitialized) {
-                arcadeEnemies.clear();
-
-                player = Entity(
-                    EntityKind::Player,
-                    center,
-                    RADIUS * 1.5f,
-                    sf::Vector2f(0.f, 0.f)
-                );
-
-                // enemigos iniciales
-                for (int i = 0; i < 45; ++i) {
-                    sf::Vector2f pos;
-                    do {
-                        pos = sf::Vector2f(
-                            static_cast<float>(std::rand() % WIDTH),
-                            static_cast<float>(std::rand() % HEIGHT)
-                        );
-                    } while (length(pos - center) < safeRadius);
-
-                    sf::Vector2f vel(
-                        (std::rand() % 100 - 50) / 80.f,
-                        (std::rand() % 100 - 50) / 80.f
-                    );
-                    Entity e(EntityKind::Enemy, pos, RADIUS, vel);
-                    e.fusionStage = 0; // verde
-                    arcadeEnemies.push_back(e);
-                }
-
-                arcadeInitialized = true;
-                arcadeGameOver = false;
-                arcadeSurvivalTime = 0.f;
-                arcadeSpawnTimer = 0.f;
-            }
-
-            player.colliding = false;
-            for (auto& e : arcadeEnemies) e.colliding = false;
-
-            if (!arcadeGameOver) {
-                arcadeSurvivalTime += dt;
-                arcadeSpawnTimer += dt;
-
-                // movimiento jugador (con WASD o flechas)
-                sf::Vector2f dir(0.f, 0.f);
+            // movimiento jugador (con WASD o flechas); se aplica desde el próximo tick
+            sf::Vector2f dir(0.f, 0.f);
+            {
+                Profiler::Scope inputScope(profiler, Profiler::Phase::Input);
                 if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::A) ||
                     sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Left))
                     dir.x -= 1.f;
@@ -371,171 +466,23 @@ int main() {
                 if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::S) ||
                     sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Down))
                     dir.y += 1.f;
+            }
 
-                dir = normalize(dir);
-                const float playerSpeed = 200.f;
-                sf::Vector2f ppos = player.shape.getPosition();
-                ppos += dir * playerSpeed * dt;
-
-                float pR = player.shape.getRadius();
-                if (ppos.x - pR < 0.f) ppos.x = pR;
-                if (ppos.x + pR > WIDTH) ppos.x = WIDTH - pR;
-                if (ppos.y - pR < 0.f) ppos.y = pR;
-                if (ppos.y + pR > HEIGHT) ppos.y = HEIGHT - pR;
-                player.shape.setPosition(ppos);
-
-                // generación de nuevos enemigos
-                if (arcadeSpawnTimer >= 3.f &&
-                    static_cast<int>(arcadeEnemies.size()) < arcadeMaxEnemies) {
-                    arcadeSpawnTimer = 0.f;
-                    sf::Vector2f pos;
-                    do {
-                        pos = sf::Vector2f(
-                            static_cast<float>(std::rand() % WIDTH),
-                            static_cast<float>(std::rand() % HEIGHT)
-                        );
-                    } while (length(pos - center) < safeRadius);
-
-                    sf::Vector2f vel(
-                        (std::rand() % 100 - 50) / 80.f,
-                        (std::rand() % 100 - 50) / 80.f
-                    );
-                    Entity e(EntityKind::Enemy, pos, RADIUS, vel);
-                    e.fusionStage = 0;
-                    arcadeEnemies.push_back(e);
-                }
-
-                // movimiento enemigos
-                for (auto& e : arcadeEnemies) {
-                    float r = e.shape.getRadius();
-                    sf::Vector2f pos = e.shape.getPosition();
-                    pos += e.velocity * 100.f * dt * (r / RADIUS);
-
-                    if (pos.x - r < 0.f) {
-                        pos.x = r;
-                        e.velocity.x *= -1.f;
-                    } else if (pos.x + r > WIDTH) {
-                        pos.x = WIDTH - r;
-                        e.velocity.x *= -1.f;
-                    }
-
-                    if (pos.y - r < 0.f) {
-                        pos.y = r;
-                        e.velocity.y *= -1.f;
-                    } else if (pos.y + r > HEIGHT) {
-                        pos.y = HEIGHT - r;
-                        e.velocity.y *= -1.f;
-                    }
-
-                    e.shape.setPosition(pos);
-                }
-
-                // reconstruir QuadTree
-                quadArcade.reset();
-                for (auto& e : arcadeEnemies) {
-                    quadArcade.insert(&e);
-                }
-
-                const int MAX_STAGE = 5;
-                std::vector<bool> alive(arcadeEnemies.size(), true);
-
-                // fusiones usando QuadTree
-                for (std::size_t i = 0; i < arcadeEnemies.size(); ++i) {
-                    if (!alive[i]) continue;
-                    auto& e = arcadeEnemies[i];
-                    sf::Vector2f pos = e.shape.getPosition();
-                    float r = e.shape.getRadius();
-                    float querySize = r * 4.f;
-
-                    sf::FloatRect range(
-                        {pos.x - querySize / 2.f, pos.y - querySize / 2.f},
-                        {querySize, querySize}
-                    );
-
-                    std::vector<Entity*> candidates;
-                    quadArcade.queryRange(range, candidates);
-
-                    for (auto* otherPtr : candidates) {
-                        if (&e == otherPtr) continue;
-
-                        std::size_t j = arcadeEnemies.size();
-                        for (std::size_t k = 0; k < arcadeEnemies.size(); ++k) {
-                            if (&arcadeEnemies[k] == otherPtr) {
-                                j = k;
-                                break;
-                            }
-                        }
-                        if (j == arcadeEnemies.size() || !alive[j]) continue;
-
-                        auto& o = arcadeEnemies[j];
-                        sf::Vector2f diff = o.shape.getPosition() - pos;
-                        float dist = length(diff);
-                        float rSum = r + o.shape.getRadius();
-
-                        if (dist < rSum * 0.9f) {
-                            float r2 = o.shape.getRadius();
-                            float newArea = r * r + r2 * r2;
-                            float newRadius = std::sqrt(newArea);
-
-                            sf::Vector2f newPos = (pos + o.shape.getPosition()) * 0.5f;
-                            sf::Vector2f newVel = (e.velocity + o.velocity) * 0.5f;
-
-                            e.shape.setRadius(newRadius);
-                            e.shape.setOrigin(sf::Vector2f(newRadius, newRadius));
-                            e.shape.setPosition(newPos);
-                            e.velocity = newVel;
-
-                            int newStage = e.fusionStage;
-                            if (o.fusionStage > newStage) newStage = o.fusionStage;
-                            if (newStage < MAX_STAGE) newStage += 1;
-                            e.fusionStage = newStage;
-
-                            alive[j] = false;
-                        }
-                    }
-                }
-
-                std::vector<Entity> newEnemies;
-                newEnemies.reserve(arcadeEnemies.size());
-                for (std::size_t i = 0; i < arcadeEnemies.size(); ++i) {
-                    if (alive[i]) newEnemies.push_back(arcadeEnemies[i]);
-                }
-                arcadeEnemies.swap(newEnemies);
-
-                quadArcade.reset();
-                for (auto& e : arcadeEnemies) {
-                    quadArcade.insert(&e);
-                }
+            simThread.setInput(dir);
 
-                // muerte del jugador (colisión)
-                sf::Vector2f p = player.shape.getPosition();
-                float querySizeP = 200.f;
-                sf::FloatRect rangeP(
-                    {p.x - querySizeP / 2.f, p.y - querySizeP / 2.f},
-                    {querySizeP, querySizeP}
-                );
-
-                std::vector<Entity*> candidatesP;
-                quadArcade.queryRange(rangeP, candidatesP);
-
-                for (auto* enemy : candidatesP) {
-                    sf::Vector2f diff = enemy->shape.getPosition() - p;
-                    float dist = length(diff);
-                    float rP = player.shape.getRadius();
-                    float rE = enemy->shape.getRadius();
-
-                    if (dist < rP + rE) {
-                        player.colliding = true;
-                        arcadeGameOver = true;
-                        break;
-                    }
-                }
+            // la cámara sigue al jugador interpolado, sin salir del mundo
+            if (snap) {
+                const sf::Vector2f focus = clampCamera(snap->playerPosition(alpha), screen, world);
+                camera.setCenter(focus);
+                simThread.setView(cullRect(focus));
             }
 
             // colores y dibujo
+            Profiler::Scope renderScope(profiler, Profiler::Phase::Render);
             window.clear();
             if (bgSprite) window.draw(*bgSprite);
-            if (showGridArcade) quadArcade.draw(window);
+            window.setView(camera);
+            if (snap && snap->hasGrid) snap->grid.draw(window);
 
             auto colorFromStage = [](int stage) -> sf::Color {
                 switch (stage) {
@@ -549,29 +496,52 @@ int main() {
                 }
             };
 
-            for (auto& e : arcadeEnemies) {
-                float baseSize = e.shape.getRadius() * 3.f;
-                sf::Color c = colorFromStage(e.fusionStage);
-                drawAlien(window, e.shape.getPosition(), baseSize, c);
+            // resize() no libera memoria al achicar, asi el arreglo se
+            // rellena en el mismo buffer frame a frame
+            const std::size_t count = snap ? snap->size() : 0;
+            alienVertices.resize(count * alienVertexCount);
+            std::size_t v = 0;
+            for (std::size_t i = 0; i < count; ++i) {
+                float baseSize = snap->radius[i] * 3.f;
+                sf::Color c = colorFromStage(snap->stage[i]);
+                v = writeAlien(alienVertices, v, snap->position(i, alpha), baseSize, c);
             }
+            window.draw(alienVertices);
+
+            if (snap) {
+                playerShape.setRadius(snap->playerRadius);
+                playerShape.setOrigin({snap->playerRadius, snap->playerRadius});
+                playerShape.setPosition(snap->playerPosition(alpha));
+                playerShape.setFillColor(snap->playerColliding ? sf::Color::Red : sf::Color::Green);
+                window.draw(playerShape);
+            }
+            window.setView(window.getDefaultView());
 
-            player.shape.setFillColor(player.colliding ? sf::Color::Red : sf::Color::Green);
-            window.draw(player.shape);
-
-            if (hasFont) {
+            if (hasFont && snap) {
                 std::string msg;
-                if (!arcadeGameOver) {
+                if (!snap->gameOver) {
                     msg =
                         "MODO ARCADE\n"
-                        "Tiempo: " + formatTime(arcadeSurvivalTime) + "\n"
-                        "Move: WASD / Flechas\n"
-                        "[ESPACE] Quadtree | [R] Reiniciar | [M] Menu | [ESC] Salir";
+                        "Tiempo: " + formatTime(snap->survival) + "\n"
+                        "Move: WASD / Flechas | [B] Fase amplia: " + std::string(broadPhaseName(broadPhase)) + "\n"
+                        "[ESPACE] Quadtree | [T] Auto-ajuste | [R] Reiniciar | [M] Menu | [ESC] Salir";
                 } else {
                     msg =
                         "GAME OVER\n"
-                        "Tiempo: " + formatTime(arcadeSurvivalTime) + "\n"
+                        "Tiempo: " + formatTime(snap->survival) + "\n"
                         "[R] Reiniciar | [M] Menu | [ESC] Salir";
                 }
+                if (worldScale > 1.f) {
+                    char line[64];
+                    std::snprintf(line, sizeof(line), "\nvisibles %zu de %zu", snap->size(), snap->total);
+                    msg += line;
+                }
+                if (snap->hasGrid && snap->broadPhase == BroadPhaseKind::QuadTree) {
+                    char line[64];
+                    std::snprintf(line, sizeof(line), "\ncapacity %d | prof. max %d%s",
+                                  snap->capacity, snap->maxDepth, snap->autoTune ? " (auto)" : "");
+                    msg += line;
+                }
                 sf::Text t(font, msg, 16);
                 auto bounds = t.getLocalBounds();
                 t.setOrigin(sf::Vector2f(bounds.size.x / 2.f, 0.f));
@@ -581,14 +551,13 @@ int main() {
                 t.setOutlineThickness(2.f);
                 window.draw(t);
             }
-
-            window.display();
         }
 
         // ======================================================
         //                        MENU
         // ======================================================
         else {
+            Profiler::Scope renderScope(profiler, Profiler::Phase::Render);
             window.clear();
             if (bgSprite) window.draw(*bgSprite);
 
@@ -629,9 +598,21 @@ int main() {
                 opt3.setOutlineThickness(2.f);
                 window.draw(opt3);
             }
+        }
 
+        {
+            Profiler::Scope renderScope(profiler, Profiler::Phase::Render);
+            profiler.draw(window, hasFont ? &font : nullptr,
+                          sf::Vector2f(10.f, static_cast<float>(HEIGHT) - 264.f));
+            if (profiler.enabled() && hasFont && current != Screen::Menu)
+                drawBroadPhaseTable(window, font, broadPhaseTimes, broadPhase,
+                                    sf::Vector2f(270.f, static_cast<float>(HEIGHT) - 198.f));
+        }
+        {
+            Profiler::Scope displayScope(profiler, Profiler::Phase::Display);
             window.display();
         }
+        profiler.endFrame();
     }
 
     return 0;
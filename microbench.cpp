@@ -0,0 +1,595 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include "EntityStore.h"
+#include "EntityQuadTree.h"
+#include "LinearQuadTree.h"
+
+// Microbenchmarks del QuadTree contra fuerza bruta O(n²):
+//   insert   reset + insertar n entidades          (ns por entidad)
+//   reset    rebobinar un árbol lleno              (ns por llamada)
+//   query_*  queryRange de lado 1%, 10% y 50% del mundo (ns por consulta)
+//   collide  build + todos los pares en colisión   (ns por frame)
+//   knn_*    nearest() de los 8 más cercanos, sin límite y a 40 px
+//            (ns por consulta, sin "linear")
+//   raycast  primer impacto de un rayo: direcciones al azar, paralelas a los
+//            ejes y desde dentro de un círculo (ns por rayo, sin "linear")
+// sobre distribuciones uniforme, agrupada y todas en el mismo punto, y un
+// barrido de capacity. Cada resultado es la mediana de --reps repeticiones.
+// "quadtree" es el árbol del juego (arreglo de 8 objetos por nodo y cubetas
+// de desborde encadenadas si capacity es mayor); "fixed" es el mismo árbol
+// con Capacity igual a capacity, asi cada hoja llena entra justo en su
+// arreglo. "fixed" solo corre con capacity 1, 2, 4, 8, 16, 32 o 64.
+//
+//   quadtree_microbench [--n 1000,10000,100000] [--capacity 1,2,4,8,16,32,64]
+//                       [--reps 5] [--queries 1000] [--seed 1]
+//                       [--max-quadratic 20000] [--format csv|json] [--out archivo]
+//
+// La fuerza bruta y el caso "coincident" (todo cae en un nodo) son cuadráticos;
+// con n > --max-quadratic se omiten.
+//
+// El checksum de cada consulta y de collide es el mismo para todas las
+// estructuras y la fuerza bruta si devuelven lo mismo (en el mismo orden, en
+// knn); si alguno difiere se avisa en stderr y el programa sale con código 2.
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr float WIDTH = 800.f;
+constexpr float HEIGHT = 600.f;
+constexpr float RADIUS = 6.f;
+
+// el caso "coincident" apila todo en un punto dentro de un cuadrante, lejos
+// de las líneas de división hasta la profundidad máxima, con un radio tan
+// chico que el círculo baja hasta ahí: mide la cubeta de desborde
+const sf::Vector2f PILE(WIDTH / 4.f + 0.5f, HEIGHT / 4.f + 0.5f);
+constexpr float PILE_RADIUS = 0.0004f;
+
+struct Options {
+    std::vector<int> counts{1000, 10000, 100000};
+    std::vector<int> capacities{1, 2, 4, 8, 16, 32, 64};
+    int reps = 5;
+    int queries = 1000;
+    unsigned seed = 1;
+    int maxQuadratic = 20000;
+    bool json = false;
+    const char* out = nullptr;
+};
+
+struct Result {
+    std::string structure;
+    std::string distribution;
+    int n;
+    int capacity; // 0 en fuerza bruta
+    std::string bench;
+    double nsPerOp;
+    std::uint64_t ops;
+    std::uint64_t checksum; // pares o resultados encontrados: evita que se optimice
+};
+
+std::vector<int> parseList(const char* text) {
+    std::vector<int> values;
+    std::string item;
+    for (const char* c = text;; ++c) {
+        if (*c == ',' || *c == '\0') {
+            if (!item.empty()) values.push_back(std::atoi(item.c_str()));
+            item.clear();
+            if (*c == '\0') break;
+        } else {
+            item += *c;
+        }
+    }
+    return values;
+}
+
+bool parse(int argc, char** argv, Options& opt) {
+    for (int a = 1; a < argc; ++a) {
+        const bool hasValue = a + 1 < argc;
+        if (std::strcmp(argv[a], "--n") == 0 && hasValue)
+            opt.counts = parseList(argv[++a]);
+        else if (std::strcmp(argv[a], "--capacity") == 0 && hasValue)
+            opt.capacities = parseList(argv[++a]);
+        else if (std::strcmp(argv[a], "--reps") == 0 && hasValue)
+            opt.reps = std::atoi(argv[++a]);
+        else if (std::strcmp(argv[a], "--queries") == 0 && hasValue)
+            opt.queries = std::atoi(argv[++a]);
+        else if (std::strcmp(argv[a], "--seed") == 0 && hasValue)
+            opt.seed = static_cast<unsigned>(std::strtoul(argv[++a], nullptr, 10));
+        else if (std::strcmp(argv[a], "--max-quadratic") == 0 && hasValue)
+            opt.maxQuadratic = std::atoi(argv[++a]);
+        else if (std::strcmp(argv[a], "--format") == 0 && hasValue)
+            opt.json = std::strcmp(argv[++a], "json") == 0;
+        else if (std::strcmp(argv[a], "--out") == 0 && hasValue)
+            opt.out = argv[++a];
+        else
+            return false;
+    }
+    return !opt.counts.empty() && !opt.capacities.empty() && opt.reps > 0 && opt.queries > 0;
+}
+
+// ------------------ distribuciones ------------------
+
+enum class Distribution {
+    Uniform,
+    Clustered,
+    Coincident
+};
+
+const char* name(Distribution d) {
+    switch (d) {
+        case Distribution::Uniform: return "uniform";
+        case Distribution::Clustered: return "clustered";
+        case Distribution::Coincident: return "coincident";
+    }
+    return "";
+}
+
+EntityStore generate(Distribution d, int n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> ux(RADIUS, WIDTH - RADIUS);
+    std::uniform_real_distribution<float> uy(RADIUS, HEIGHT - RADIUS);
+
+    // 16 grupos con desviación de 2% del ancho
+    std::vector<sf::Vector2f> centers;
+    for (int c = 0; c < 16; ++c) {
+        const float x = ux(rng);
+        const float y = uy(rng);
+        centers.push_back({x, y});
+    }
+    std::normal_distribution<float> spread(0.f, WIDTH * 0.02f);
+
+    EntityStore store;
+    store.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        sf::Vector2f pos = PILE;
+        float radius = PILE_RADIUS;
+        if (d == Distribution::Uniform) {
+            radius = RADIUS;
+            pos.x = ux(rng);
+            pos.y = uy(rng);
+        } else if (d == Distribution::Clustered) {
+            radius = RADIUS;
+            const sf::Vector2f c = centers[rng() % centers.size()];
+            const float dx = spread(rng);
+            const float dy = spread(rng);
+            pos.x = std::clamp(c.x + dx, RADIUS, WIDTH - RADIUS);
+            pos.y = std::clamp(c.y + dy, RADIUS, HEIGHT - RADIUS);
+        }
+        store.add(pos, radius, {0.f, 0.f});
+    }
+    return store;
+}
+
+std::vector<sf::FloatRect> queryRects(float fraction, int count, unsigned seed) {
+    std::mt19937 rng(seed);
+    const sf::Vector2f size(WIDTH * fraction, HEIGHT * fraction);
+    std::uniform_real_distribution<float> ux(0.f, WIDTH - size.x);
+    std::uniform_real_distribution<float> uy(0.f, HEIGHT - size.y);
+    std::vector<sf::FloatRect> rects;
+    for (int q = 0; q < count; ++q) {
+        const float x = ux(rng);
+        const float y = uy(rng);
+        rects.push_back(sf::FloatRect({x, y}, size));
+    }
+    return rects;
+}
+
+// ------------------ medición ------------------
+
+// mediana de reps llamadas a fn(), que devuelve su checksum
+template <typename F>
+double medianNs(int reps, std::uint64_t& checksum, F&& fn) {
+    std::vector<double> samples;
+    for (int r = 0; r < reps; ++r) {
+        const Clock::time_point start = Clock::now();
+        checksum = fn();
+        samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+    }
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+    return samples[samples.size() / 2];
+}
+
+struct QuerySet {
+    const char* bench;
+    std::vector<sf::FloatRect> rects;
+};
+
+std::vector<sf::Vector2f> queryPoints(int count, unsigned seed) {
+    std::mt19937 rng(seed + 1);
+    std::uniform_real_distribution<float> ux(0.f, WIDTH);
+    std::uniform_real_distribution<float> uy(0.f, HEIGHT);
+    std::vector<sf::Vector2f> points;
+    for (int q = 0; q < count; ++q) {
+        const float x = ux(rng);
+        const float y = uy(rng);
+        points.push_back({x, y});
+    }
+    return points;
+}
+
+// nearest(): k vecinos, sin límite de distancia y a 40 px
+struct KnnSet {
+    const char* bench;
+    float maxDist;
+};
+constexpr std::size_t KNN_K = 8;
+const KnnSet KNN_SETS[] = {{"knn_8", WIDTH + HEIGHT}, {"knn_8_40px", 40.f}};
+
+// raycast(): origin + t * dir con t en [0, maxT]
+struct Ray {
+    sf::Vector2f origin;
+    sf::Vector2f dir;
+    float maxT;
+};
+
+// un cuarto de cada tipo: dirección al azar, paralelo a un eje, desde dentro
+// de un círculo y paralelo a un eje pasando por el centro o el borde de un
+// círculo (empates y tangentes)
+std::vector<Ray> queryRays(const EntityStore& store, int count, unsigned seed) {
+    std::mt19937 rng(seed + 2);
+    std::uniform_real_distribution<float> ux(0.f, WIDTH);
+    std::uniform_real_distribution<float> uy(0.f, HEIGHT);
+    std::uniform_real_distribution<float> angle(0.f, 6.2831853f);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::uniform_int_distribution<int> entity(0, static_cast<int>(store.size()) - 1);
+    const sf::Vector2f axes[] = {{1.f, 0.f}, {-1.f, 0.f}, {0.f, 1.f}, {0.f, -1.f}};
+    const float maxT = WIDTH + HEIGHT;
+
+    std::vector<Ray> rays;
+    for (int q = 0; q < count; ++q) {
+        const float a = angle(rng);
+        const sf::Vector2f dir{2.f * std::cos(a), 2.f * std::sin(a)}; // sin normalizar
+        const sf::Vector2f axis = axes[q / 4 % 4];
+        switch (q % 4) {
+            case 0: {
+                const float x = ux(rng);
+                const float y = uy(rng);
+                rays.push_back({{x, y}, dir, maxT});
+                break;
+            }
+            case 1: {
+                const float x = ux(rng);
+                const float y = uy(rng);
+                rays.push_back({{x, y}, axis, maxT});
+                break;
+            }
+            case 2: {
+                const int i = entity(rng);
+                const float r = 0.5f * unit(rng) * store.radius[i];
+                rays.push_back({{store.x[i] + r * std::cos(a), store.y[i] + r * std::sin(a)}, dir, maxT});
+                break;
+            }
+            default: {
+                const int i = entity(rng);
+                const float offset = (q / 16 % 2) ? store.radius[i] : 0.f;
+                const sf::Vector2f perp{-axis.y, axis.x};
+                const sf::Vector2f through{store.x[i] + perp.x * offset, store.y[i] + perp.y * offset};
+                const float back = 3.f * store.radius[i] + 50.f * unit(rng);
+                rays.push_back({{through.x - axis.x * back, through.y - axis.y * back}, axis, maxT});
+                break;
+            }
+        }
+    }
+    return rays;
+}
+
+// Id + 1 del impacto, 0 si no hay; RayHit de cualquier Capacity
+template <typename Hit>
+std::uint64_t hashHit(std::uint64_t h, const std::optional<Hit>& hit) {
+    return h * 1000003u + (hit ? hit->id + 1u : 0u);
+}
+
+// mezcla los Id en orden: dos listas iguales dan el mismo valor
+std::uint64_t hashIds(std::uint64_t h, const std::vector<QuadTree::Id>& ids) {
+    for (QuadTree::Id id : ids) h = h * 1000003u + id + 1u;
+    return h * 1000003u + ids.size();
+}
+
+// círculo contra rectángulo, igual que QuadTree::overlaps
+bool circleInRect(const sf::FloatRect& range, float x, float y, float r) {
+    const float nx = std::clamp(x, range.position.x, range.position.x + range.size.x);
+    const float ny = std::clamp(y, range.position.y, range.position.y + range.size.y);
+    const float dx = x - nx;
+    const float dy = y - ny;
+    return dx * dx + dy * dy < r * r;
+}
+
+template <typename Tree>
+void runTree(const char* structure, Distribution d, const EntityStore& store, int capacity,
+             const std::vector<QuerySet>& querySets, const std::vector<sf::Vector2f>& points,
+             const std::vector<Ray>& rays, const Options& opt, std::vector<Result>& results) {
+    const int n = static_cast<int>(store.size());
+    const std::uint64_t ops = static_cast<std::uint64_t>(n);
+    Tree tree(sf::FloatRect({0.f, 0.f}, {WIDTH, HEIGHT}), capacity);
+    std::uint64_t checksum = 0;
+
+    std::vector<QuadTree::Id> found;
+
+    // una pasada de calentamiento para que el pool de nodos ya tenga memoria
+    tree.build(store);
+
+    double ns = medianNs(opt.reps, checksum, [&] {
+        tree.reset();
+        for (int i = 0; i < n; ++i)
+            tree.insert(static_cast<QuadTree::Id>(i), store);
+        // LinearQuadTree ordena recién en la primera consulta; una vacía lo fuerza
+        found.clear();
+        tree.queryRange(sf::FloatRect({0.f, 0.f}, {0.f, 0.f}), found);
+        return static_cast<std::uint64_t>(n);
+    });
+    results.push_back({structure, name(d), n, capacity, "insert", ns / std::max(n, 1), ops, checksum});
+
+    ns = medianNs(opt.reps, checksum, [&] {
+        tree.build(store);
+        const Clock::time_point start = Clock::now();
+        tree.reset();
+        // solo cuenta reset(): se descuenta el build de la medición
+        return static_cast<std::uint64_t>(
+            std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+    });
+    results.push_back({structure, name(d), n, capacity, "reset", static_cast<double>(checksum), 1, 0});
+
+    tree.build(store);
+    for (const QuerySet& set : querySets) {
+        ns = medianNs(opt.reps, checksum, [&] {
+            std::uint64_t hits = 0;
+            for (const sf::FloatRect& rect : set.rects) {
+                found.clear();
+                tree.queryRange(rect, found);
+                hits += found.size();
+            }
+            return hits;
+        });
+        results.push_back({structure, name(d), n, capacity, set.bench,
+                           ns / set.rects.size(), set.rects.size(), checksum});
+    }
+
+    if constexpr (!std::is_same_v<Tree, LinearQuadTree>) {
+        for (const KnnSet& set : KNN_SETS) {
+            ns = medianNs(opt.reps, checksum, [&] {
+                std::uint64_t h = 0;
+                for (const sf::Vector2f& p : points) {
+                    tree.nearest(p, KNN_K, set.maxDist, found);
+                    h = hashIds(h, found);
+                }
+                return h;
+            });
+            results.push_back({structure, name(d), n, capacity, set.bench,
+                               ns / points.size(), points.size(), checksum});
+        }
+
+        ns = medianNs(opt.reps, checksum, [&] {
+            std::uint64_t h = 0;
+            for (const Ray& ray : rays) h = hashHit(h, tree.raycast(ray.origin, ray.dir, ray.maxT));
+            return h;
+        });
+        results.push_back({structure, name(d), n, capacity, "raycast", ns / rays.size(), rays.size(),
+                           checksum});
+    }
+
+    if (d == Distribution::Coincident && n > opt.maxQuadratic) return;
+    ns = medianNs(opt.reps, checksum, [&] {
+        tree.build(store);
+        std::uint64_t pairs = 0;
+        tree.forEachCollidingPair(1.f, [&](QuadTree::Id, QuadTree::Id) { ++pairs; });
+        return pairs;
+    });
+    results.push_back({structure, name(d), n, capacity, "collide", ns, 1, checksum});
+}
+
+// Capacity es un parámetro de plantilla: solo las potencias de 2 del barrido
+void runFixed(int capacity, Distribution d, const EntityStore& store,
+              const std::vector<QuerySet>& querySets, const std::vector<sf::Vector2f>& points,
+              const std::vector<Ray>& rays, const Options& opt, std::vector<Result>& results) {
+    switch (capacity) {
+        case 1: runTree<EntityQuadTree<1>>("fixed", d, store, capacity, querySets, points, rays, opt, results); break;
+        case 2: runTree<EntityQuadTree<2>>("fixed", d, store, capacity, querySets, points, rays, opt, results); break;
+        case 4: runTree<EntityQuadTree<4>>("fixed", d, store, capacity, querySets, points, rays, opt, results); break;
+        case 8: runTree<EntityQuadTree<8>>("fixed", d, store, capacity, querySets, points, rays, opt, results); break;
+        case 16: runTree<EntityQuadTree<16>>("fixed", d, store, capacity, querySets, points, rays, opt, results); break;
+        case 32: runTree<EntityQuadTree<32>>("fixed", d, store, capacity, querySets, points, rays, opt, results); break;
+        case 64: runTree<EntityQuadTree<64>>("fixed", d, store, capacity, querySets, points, rays, opt, results); break;
+        default: break;
+    }
+}
+
+void runBruteForce(Distribution d, const EntityStore& store, const std::vector<QuerySet>& querySets,
+                   const std::vector<sf::Vector2f>& points, const std::vector<Ray>& rays,
+                   const Options& opt, std::vector<Result>& results) {
+    const int n = static_cast<int>(store.size());
+    std::uint64_t checksum = 0;
+
+    for (const QuerySet& set : querySets) {
+        const double ns = medianNs(opt.reps, checksum, [&] {
+            std::uint64_t hits = 0;
+            for (const sf::FloatRect& rect : set.rects) {
+                for (int i = 0; i < n; ++i)
+                    hits += circleInRect(rect, store.x[i], store.y[i], store.radius[i]);
+            }
+            return hits;
+        });
+        results.push_back({"brute", name(d), n, 0, set.bench, ns / set.rects.size(),
+                           set.rects.size(), checksum});
+    }
+
+    // los k menores por (distancia², Id), con la misma cuenta que nearest()
+    std::vector<std::pair<float, QuadTree::Id>> byDistance;
+    std::vector<QuadTree::Id> found;
+    for (const KnnSet& set : KNN_SETS) {
+        const float max2 = set.maxDist * set.maxDist;
+        const double ns = medianNs(opt.reps, checksum, [&] {
+            std::uint64_t h = 0;
+            for (const sf::Vector2f& p : points) {
+                byDistance.clear();
+                for (int i = 0; i < n; ++i) {
+                    const float dx = store.x[i] - p.x;
+                    const float dy = store.y[i] - p.y;
+                    const float d2 = dx * dx + dy * dy;
+                    if (d2 <= max2) byDistance.push_back({d2, static_cast<QuadTree::Id>(i)});
+                }
+                const std::size_t k = std::min(KNN_K, byDistance.size());
+                std::partial_sort(byDistance.begin(), byDistance.begin() + k, byDistance.end());
+                found.clear();
+                for (std::size_t i = 0; i < k; ++i) found.push_back(byDistance[i].second);
+                h = hashIds(h, found);
+            }
+            return h;
+        });
+        results.push_back({"brute", name(d), n, 0, set.bench, ns / points.size(), points.size(),
+                           checksum});
+    }
+
+    // el menor t con la misma cuenta que QuadTree::raycast(), empates por Id
+    const double rayNs = medianNs(opt.reps, checksum, [&] {
+        std::uint64_t h = 0;
+        for (const Ray& ray : rays) {
+            std::optional<QuadTree::RayHit> best;
+            for (int i = 0; i < n; ++i) {
+                const float ox = ray.origin.x - store.x[i];
+                const float oy = ray.origin.y - store.y[i];
+                const float c = ox * ox + oy * oy - store.radius[i] * store.radius[i];
+                float t = 0.f;
+                if (c > 0.f) {
+                    const float a = ray.dir.x * ray.dir.x + ray.dir.y * ray.dir.y;
+                    const float b = ox * ray.dir.x + oy * ray.dir.y;
+                    if (a == 0.f || b >= 0.f) continue;
+                    const float tc = -b / a;
+                    const float px = ox + tc * ray.dir.x;
+                    const float py = oy + tc * ray.dir.y;
+                    const float h = store.radius[i] * store.radius[i] - (px * px + py * py);
+                    if (h < 0.f) continue;
+                    t = std::max(0.f, tc - std::sqrt(h / a));
+                    if (t > ray.maxT) continue;
+                }
+                if (!best || t < best->t) best = QuadTree::RayHit{static_cast<QuadTree::Id>(i), t};
+            }
+            h = hashHit(h, best);
+        }
+        return h;
+    });
+    results.push_back({"brute", name(d), n, 0, "raycast", rayNs / rays.size(), rays.size(), checksum});
+
+    if (n > opt.maxQuadratic) return;
+    const double ns = medianNs(opt.reps, checksum, [&] {
+        std::uint64_t pairs = 0;
+        for (int i = 0; i < n; ++i) {
+            for (int j = i + 1; j < n; ++j) {
+                const float dx = store.x[j] - store.x[i];
+                const float dy = store.y[j] - store.y[i];
+                const float lim = store.radius[i] + store.radius[j];
+                pairs += dx * dx + dy * dy < lim * lim;
+            }
+        }
+        return pairs;
+    });
+    results.push_back({"brute", name(d), n, 0, "collide", ns, 1, checksum});
+}
+
+void write(std::FILE* f, const std::vector<Result>& results, bool json) {
+    if (!json) {
+        std::fprintf(f, "structure,distribution,n,capacity,bench,ns_per_op,ops,checksum\n");
+        for (const Result& r : results) {
+            std::fprintf(f, "%s,%s,%d,%d,%s,%.1f,%llu,%llu\n", r.structure.c_str(),
+                         r.distribution.c_str(), r.n, r.capacity, r.bench.c_str(), r.nsPerOp,
+                         static_cast<unsigned long long>(r.ops),
+                         static_cast<unsigned long long>(r.checksum));
+        }
+        return;
+    }
+
+    std::fprintf(f, "{\n  \"kernel\": \"%s\",\n  \"results\": [\n", narrow::kernelName());
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        std::fprintf(f,
+                     "    {\"structure\": \"%s\", \"distribution\": \"%s\", \"n\": %d, "
+                     "\"capacity\": %d, \"bench\": \"%s\", \"ns_per_op\": %.1f, "
+                     "\"ops\": %llu, \"checksum\": %llu}%s\n",
+                     r.structure.c_str(), r.distribution.c_str(), r.n, r.capacity,
+                     r.bench.c_str(), r.nsPerOp, static_cast<unsigned long long>(r.ops),
+                     static_cast<unsigned long long>(r.checksum),
+                     i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(f, "  ]\n}\n");
+}
+
+// las filas de una misma consulta (distribución, n, bench) deben tener el
+// mismo checksum; insert y reset no devuelven resultados
+int verify(const std::vector<Result>& results) {
+    int mismatches = 0;
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const Result& a = results[i];
+        if (a.bench == "insert" || a.bench == "reset") continue;
+        for (std::size_t j = 0; j < i; ++j) {
+            const Result& b = results[j];
+            if (b.bench != a.bench || b.distribution != a.distribution || b.n != a.n) continue;
+            if (b.checksum != a.checksum) {
+                std::fprintf(stderr, "checksum distinto: %s %s n=%d: %s/%d=%llu, %s/%d=%llu\n",
+                             a.bench.c_str(), a.distribution.c_str(), a.n,
+                             b.structure.c_str(), b.capacity,
+                             static_cast<unsigned long long>(b.checksum), a.structure.c_str(),
+                             a.capacity, static_cast<unsigned long long>(a.checksum));
+                ++mismatches;
+            }
+            break;
+        }
+    }
+    return mismatches;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse(argc, argv, opt)) {
+        std::fprintf(stderr,
+                     "uso: %s [--n 1000,10000] [--capacity 1,4,16] [--reps R] [--queries Q]\n"
+                     "       [--seed S] [--max-quadratic N] [--format csv|json] [--out archivo]\n",
+                     argv[0]);
+        return 1;
+    }
+
+    const std::vector<sf::Vector2f> points = queryPoints(opt.queries, opt.seed);
+    const std::vector<QuerySet> querySets{
+        {"query_1pct", queryRects(0.01f, opt.queries, opt.seed)},
+        {"query_10pct", queryRects(0.10f, opt.queries, opt.seed)},
+        {"query_50pct", queryRects(0.50f, opt.queries, opt.seed)},
+    };
+
+    std::vector<Result> results;
+    for (Distribution d : {Distribution::Uniform, Distribution::Clustered, Distribution::Coincident}) {
+        for (int n : opt.counts) {
+            if (n <= 0) continue;
+            const EntityStore store = generate(d, n, opt.seed);
+            const std::vector<Ray> rays = queryRays(store, opt.queries, opt.seed);
+            std::fprintf(stderr, "%s n=%d\n", name(d), n);
+
+            for (int capacity : opt.capacities) {
+                if (capacity <= 0) continue;
+                runTree<QuadTree>("quadtree", d, store, capacity, querySets, points, rays, opt, results);
+                runTree<LinearQuadTree>("linear", d, store, capacity, querySets, points, rays, opt, results);
+                runFixed(capacity, d, store, querySets, points, rays, opt, results);
+            }
+            runBruteForce(d, store, querySets, points, rays, opt, results);
+        }
+    }
+
+    std::FILE* f = opt.out ? std::fopen(opt.out, "w") : stdout;
+    if (!f) {
+        std::fprintf(stderr, "no se pudo abrir %s\n", opt.out);
+        return 1;
+    }
+    write(f, results, opt.json);
+    if (f != stdout) std::fclose(f);
+    return verify(results) == 0 ? 0 : 2;
+}